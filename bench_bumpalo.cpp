@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "blockrefill.h"
+
+// Allocation latency of BumpAlo<T> under bursty load.
+//
+// usage: bench_bumpalo [no_bursts] [burst_size]
+//
+// Every burst allocates burst_size slots back to back and then idles for a
+// millisecond. The pool is never pre-sized beyond the first burst, so every
+// later burst exhausts it.
+//
+// Afterwards the cost of an Allocate/Deallocate pair is compared with and
+// without guard mode, on a pre-sized pool of burst_size slots.
+
+template <int N>
+struct Payload {
+    uint64_t data[8];
+};
+
+using Clock = std::chrono::steady_clock;
+
+static void Report(const char *name, std::vector<double> &ns) {
+    std::sort(ns.begin(), ns.end());
+    auto at = [&ns](double q) { return ns[static_cast<size_t>(q * (ns.size() - 1))]; };
+    std::printf("%-24s p50 %8.0f ns  p99 %8.0f ns  p999 %8.0f ns  max %10.0f ns\n",
+                name, at(0.5), at(0.99), at(0.999), ns.back());
+}
+
+// allocates all slots, then hands them back in shuffled order, the pool
+// is made of blocks of block_slots slots
+template <class T>
+static double NsPerAllocateDeallocate(size_t no_slots, size_t block_slots, bool guard) {
+    auto &pool = BumpAlo<T>::Get();
+    if(guard && pool.GetNoOfBlocks() == 0) {
+        pool.EnableGuard();
+    }
+    for(size_t added = pool.GetSizeOfPool(); added < no_slots; added += block_slots) {
+        pool.AddMemory(std::min(block_slots, no_slots - added));
+    }
+
+    std::vector<T *> slots(no_slots);
+    std::vector<size_t> order(no_slots);
+    for(size_t i = 0; i < no_slots; ++i) {
+        order[i] = (i * 7919) % no_slots;
+    }
+    const int no_repeats = 100;
+    auto begin = Clock::now();
+    for(int repeat = 0; repeat < no_repeats; ++repeat) {
+        for(size_t i = 0; i < no_slots; ++i) {
+            slots[i] = pool.Allocate();
+            slots[i]->data[0] = i;
+        }
+        for(size_t i = 0; i < no_slots; ++i) {
+            pool.Deallocate(slots[order[i]]);
+        }
+    }
+    auto end = Clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / (no_repeats * no_slots);
+}
+
+template <class T>
+static std::vector<double> RunBursts(size_t no_bursts, size_t burst_size) {
+    std::vector<double> ns;
+    ns.reserve(no_bursts * burst_size);
+    for(size_t b = 0; b < no_bursts; ++b) {
+        for(size_t i = 0; i < burst_size; ++i) {
+            auto begin = Clock::now();
+            T *p = BumpAlo<T>::Get().Allocate();
+            auto end = Clock::now();
+            p->data[0] = i;
+            ns.push_back(std::chrono::duration<double, std::nano>(end - begin).count());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return ns;
+}
+
+int main(int argc, char **argv) {
+    const size_t no_bursts = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200;
+    const size_t burst_size = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000;
+
+    {
+        BumpAlo<Payload<0>>::Get().AddMemory(burst_size);
+        auto ns = RunBursts<Payload<0>>(no_bursts, burst_size);
+        Report("without refill", ns);
+    }
+    {
+        BumpAlo<Payload<1>>::Get().AddMemory(burst_size);
+        BlockRefill<Payload<1>>::Get().Start(burst_size / 2, 2 * burst_size);
+        auto ns = RunBursts<Payload<1>>(no_bursts, burst_size);
+        BlockRefill<Payload<1>>::Get().Stop();
+        Report("with refill", ns);
+    }
+    {
+        // 7919 is prime, so the deallocation order is a permutation
+        const size_t no_slots = burst_size % 7919 == 0 ? burst_size + 1 : burst_size;
+        // many small blocks, so finding the block of a slot is not trivial,
+        // runs interleaved and reports the medians as the machine is noisy
+        const size_t block_slots = 16;
+        std::vector<double> plain;
+        std::vector<double> guard;
+        for(int i = 0; i < 15; ++i) {
+            plain.push_back(NsPerAllocateDeallocate<Payload<2>>(no_slots, block_slots, false));
+            guard.push_back(NsPerAllocateDeallocate<Payload<3>>(no_slots, block_slots, true));
+        }
+        std::sort(plain.begin(), plain.end());
+        std::sort(guard.begin(), guard.end());
+        const double plain_ns = plain[plain.size() / 2];
+        const double guard_ns = guard[guard.size() / 2];
+        std::printf("allocate+deallocate      plain %6.2f ns  guard %6.2f ns  overhead %6.1f %%  (%zu blocks)\n",
+                    plain_ns, guard_ns, 100.0 * (guard_ns - plain_ns) / plain_ns,
+                    BumpAlo<Payload<3>>::Get().GetNoOfBlocks());
+    }
+}
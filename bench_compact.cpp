@@ -0,0 +1,62 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include "compact.h"
+
+// Ordered iteration over a std::map with PAlo nodes, fresh, after churn and
+// after compaction.
+//
+// usage: bench_compact [no_keys] [no_rounds]
+
+using Key = uint64_t;
+using Value = uint64_t;
+using Clock = std::chrono::steady_clock;
+using Map = std::map<Key, Value, std::less<Key>, PAlo<std::pair<const Key, Value>>>;
+using MapNode = std::_Rb_tree_node<std::pair<const Key, Value>>;
+
+static void Report(const char *name, const Map &m) {
+    Value sum = 0;
+    auto begin = Clock::now();
+    for(int repeat = 0; repeat < 5; ++repeat) {
+        for(const auto &n : m) {
+            sum += n.second;
+        }
+    }
+    auto end = Clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - begin).count() / (5 * m.size());
+    std::printf("%-18s iterate %6.2f ns/node  blocks %8zu  slots %10zu  (%llu)\n", name, ns,
+                BumpAlo<MapNode>::Get().GetNoOfBlocks(), BumpAlo<MapNode>::Get().GetSizeOfPool(),
+                static_cast<unsigned long long>(sum));
+}
+
+int main(int argc, char **argv) {
+    const size_t no_keys = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const size_t no_rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10;
+
+    std::mt19937_64 rng(42);
+    Map m;
+    BumpAlo<MapNode>::Get().AddMemory(no_keys);
+    for(Key k = 0; k < no_keys; ++k) {
+        m.emplace_hint(m.end(), k, k);
+    }
+    Report("fresh", m);
+
+    // replace a tenth of the keys per round, new nodes come from wherever
+    // the last erase left a free slot
+    for(size_t round = 0; round < no_rounds; ++round) {
+        for(size_t i = 0; i < no_keys / 10; ++i) {
+            auto it = m.lower_bound(rng() % (2 * no_keys));
+            m.erase(it != m.end() ? it : m.begin());
+            m.emplace(rng() % (2 * no_keys), i);
+        }
+    }
+    Report("after churn", m);
+
+    auto begin = Clock::now();
+    Compact(m);
+    auto end = Clock::now();
+    Report("after compaction", m);
+    std::printf("compaction took %.1f ms\n", std::chrono::duration<double, std::milli>(end - begin).count());
+}
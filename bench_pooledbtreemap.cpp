@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <vector>
+#include "palo.h"
+#include "pooledbtreemap.h"
+
+// PooledBTreeMap against std::map with PAlo nodes.
+//
+// usage: bench_pooledbtreemap [no_keys]
+//
+// Both node pools are pre-sized, so neither map requests memory from the
+// OS while it is measured.
+
+using Key = uint64_t;
+using Value = uint64_t;
+using Clock = std::chrono::steady_clock;
+
+using PAloMap = std::map<Key, Value, std::less<Key>, PAlo<std::pair<const Key, Value>>>;
+using PAloMapNode = std::_Rb_tree_node<std::pair<const Key, Value>>;
+using BTreeMap = PooledBTreeMap<Key, Value>;
+
+template <class F>
+static double NsPerOp(size_t no_ops, F f) {
+    auto begin = Clock::now();
+    f();
+    auto end = Clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / no_ops;
+}
+
+template <class Map>
+static void Run(const char *name, const std::vector<Key> &keys, const std::vector<Key> &lookups) {
+    Map m;
+    Value sum = 0;
+
+    double insert = NsPerOp(keys.size(), [&] {
+        for(auto k : keys) {
+            m.insert({k, k});
+        }
+    });
+    double lookup = NsPerOp(lookups.size(), [&] {
+        for(auto k : lookups) {
+            sum += m.find(k)->second;
+        }
+    });
+    double iterate = NsPerOp(m.size(), [&] {
+        for(const auto &n : m) {
+            sum += n.second;
+        }
+    });
+    // erase and re-insert half of the keys in random order
+    double churn = NsPerOp(keys.size(), [&] {
+        for(size_t i = 0; i < keys.size() / 2; ++i) {
+            m.erase(keys[i]);
+        }
+        for(size_t i = 0; i < keys.size() / 2; ++i) {
+            m.insert({keys[i], keys[i]});
+        }
+    });
+
+    std::printf("%-16s insert %7.1f  lookup %7.1f  iterate %6.2f  churn %7.1f  ns/op  (%llu)\n",
+                name, insert, lookup, iterate, churn, static_cast<unsigned long long>(sum));
+}
+
+int main(int argc, char **argv) {
+    const size_t no_keys = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    std::mt19937_64 rng(42);
+    std::vector<Key> keys(no_keys);
+    for(auto &k : keys) {
+        k = rng();
+    }
+    std::vector<Key> lookups(keys);
+    std::shuffle(lookups.begin(), lookups.end(), rng);
+
+    BumpAlo<PAloMapNode>::Get().AddMemory(no_keys);
+    BTreeMap::ReservePool(no_keys);
+
+    std::printf("%zu keys, %zu values per b-tree node\n", no_keys, BTreeMap::GetSlotsPerNode());
+    Run<PAloMap>("std::map+PAlo", keys, lookups);
+    Run<BTreeMap>("PooledBTreeMap", keys, lookups);
+}
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include "safalo.h"
+
+// Cost of SafAlo's operator new/delete with and without the sampling heap
+// profiler.
+//
+// Off and on runs are interleaved in alternating order, so drifts of the
+// machine and effects of the order hit both. The runs are timed in CPU time
+// of the thread, time the thread is descheduled does not count.
+//
+// usage: bench_safalo [no_allocations] [mean_interval_bytes] [no_repeats]
+
+static double ThreadNs() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return 1e9 * static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec);
+}
+
+static double NsPerPair(std::vector<void *> &ptrs) {
+    const double begin = ThreadNs();
+    for(int repeat = 0; repeat < 10; ++repeat) {
+        for(size_t i = 0; i < ptrs.size(); ++i) {
+            ptrs[i] = ::operator new(16 + (i & 255));
+        }
+        for(auto p : ptrs) {
+            ::operator delete(p);
+        }
+    }
+    return (ThreadNs() - begin) / (10 * ptrs.size());
+}
+
+static double Median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+int main(int argc, char **argv) {
+    const size_t no_allocations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const size_t interval = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 512 * 1024;
+    const size_t no_repeats = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 31;
+
+    std::vector<void *> ptrs(no_allocations);
+    NsPerPair(ptrs);
+
+    std::vector<double> off;
+    std::vector<double> on;
+    std::vector<double> overhead;
+    for(size_t i = 0; i < no_repeats; ++i) {
+        // every other repeat runs with sampling first
+        if(i % 2 == 0) {
+            off.push_back(NsPerPair(ptrs));
+        }
+        SafAlo::Get().StartSampling(interval);
+        on.push_back(NsPerPair(ptrs));
+        SafAlo::Get().StopSampling();
+        if(i % 2 != 0) {
+            off.push_back(NsPerPair(ptrs));
+        }
+        overhead.push_back(100.0 * (on.back() - off.back()) / off.back());
+    }
+
+    // the overhead is the median of the pairwise overheads, each pair ran
+    // back to back, so slow drifts of the machine cancel out
+    std::printf("new+delete  median of %zu  sampling off %6.2f ns  sampling on %6.2f ns  overhead %5.2f %%"
+                "  (pairwise %5.2f %% .. %5.2f %%)\n",
+                no_repeats, Median(off), Median(on), Median(overhead),
+                *std::min_element(overhead.begin(), overhead.end()),
+                *std::max_element(overhead.begin(), overhead.end()));
+}
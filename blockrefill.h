@@ -0,0 +1,179 @@
+#ifndef BLOCKREFILL_H
+#define BLOCKREFILL_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "bumpalo.h"
+
+/// @brief BlockRefill
+///
+/// @details
+///
+///        Maintenance thread preparing blocks for the BumpAlo<T> pool. 
+///        Refill is opt-in, only code including this header needs threads.
+///
+///        BlockRefill<T>::Get().Start(low_watermark, high_watermark);
+///
+///        allocating thread : Request(n) --> ... --> Take() --> AdoptBlock
+///        refill thread     :         PrepareBlock(n) (::operator new, prefault)
+///
+///        The allocating thread asks for a block once the free slots of the
+///        pool drop below the low watermark. The refill thread requests the
+///        memory from the OS, prefaults it and links the slots. The
+///        allocating thread then only takes the prepared block over, which
+///        neither allocates nor blocks.
+///
+///        Only one block is in flight at a time. Start, Stop, Request and 
+///        Take must be called from the thread which owns the pool.
+///
+///        The refill thread sleeps on a futex without a timeout. Request
+///        changes the futex word before waking it, so a wakeup can not get
+///        lost and an idle refill thread never runs.
+///
+/// @tparam T
+template <class T>
+class BlockRefill : public BlockSource<T> {
+
+public:
+    using Block = typename BlockSource<T>::Block;
+
+    /// @brief Getter to the refill of BumpAlo<T>
+    /// @return use BlockRefill<T>::Get().Function()
+    static BlockRefill & Get() {
+        static BlockRefill instance;
+        return instance;
+    }
+
+    /// @brief Starts the refill thread
+    /// @param low_watermark a block is requested if fewer slots are free
+    /// @param high_watermark a requested block refills the pool up to this number of free slots
+    void Start(size_t low_watermark, size_t high_watermark) {
+        if(running_) {
+            std::cerr << __FUNCTION__ << " refill is already running\n";
+            std::abort();
+        }
+        if(low_watermark == 0 || high_watermark <= low_watermark) {
+            std::cerr << __FUNCTION__ << " watermarks low : " << low_watermark
+                      << " high : " << high_watermark << " are not possible\n";
+            std::abort();
+        }
+        this->low_watermark_ = low_watermark;
+        this->high_watermark_ = high_watermark;
+        state_ = kIdle;
+        running_ = true;
+        thread_ = std::thread(&BlockRefill::Run, this);
+        pool_.SetBlockSource(this);
+    }
+
+    /// @brief Stops the refill thread
+    /// @details A prepared block which has not been taken is released.
+    void Stop() {
+        if(!running_) {
+            return;
+        }
+        pool_.SetBlockSource(nullptr);
+        running_ = false;
+        Wake();
+        thread_.join();
+
+        if(state_.load(std::memory_order_acquire) == kReady) {
+            pool_.DiscardBlock(ready_);
+            ready_ = nullptr;
+        }
+        state_ = kIdle;
+    }
+
+    bool IsRunning() const {
+        return running_.load(std::memory_order_relaxed);
+    }
+
+    /// @brief GetNoOfRefilledBlocks
+    /// @return number of prepared blocks taken over by Allocate
+    size_t GetNoOfRefilledBlocks() const {
+        return no_taken_blocks_;
+    }
+
+    /// @brief Asks the refill thread for a block, never blocks
+    /// @details Ignored if a block is already requested or prepared.
+    /// @param no_free_slots free slots left in the pool
+    void Request(size_t no_free_slots) override {
+        if(state_.load(std::memory_order_acquire) != kIdle) {
+            return;
+        }
+        requested_slots_ = no_free_slots < this->high_watermark_ ? this->high_watermark_ - no_free_slots : 1;
+        state_.store(kRequested);
+        Wake();
+    }
+
+    /// @brief Takes the prepared block over, never blocks
+    /// @return prepared block or nullptr if none is ready yet
+    Block *Take() override {
+        if(state_.load(std::memory_order_acquire) != kReady) {
+            return nullptr;
+        }
+        Block *block = ready_;
+        ready_ = nullptr;
+        state_.store(kIdle, std::memory_order_release);
+        ++no_taken_blocks_;
+        return block;
+    }
+
+private:
+
+    enum State : int { kIdle, kRequested, kReady };
+
+    BlockRefill() :
+        pool_(BumpAlo<T>::Get()), running_{false}, state_{kIdle}, wakeups_{0},
+        requested_slots_{0}, ready_{nullptr}, no_taken_blocks_{0} {}
+
+    ~BlockRefill() {
+        Stop();
+    }
+
+    BlockRefill(const BlockRefill&)= delete;
+    BlockRefill& operator=(const BlockRefill&)= delete;
+
+    BumpAlo<T> &pool_;
+    std::atomic<bool> running_;
+    std::atomic<int> state_;
+    // futex word, bumped on every Request and Stop
+    std::atomic<uint32_t> wakeups_;
+    size_t requested_slots_;
+    Block *ready_;
+    size_t no_taken_blocks_;
+    std::thread thread_;
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word has to be a plain uint32_t");
+
+    uint32_t *FutexWord() {
+        return reinterpret_cast<uint32_t *>(&wakeups_);
+    }
+
+    void Wake() {
+        wakeups_.fetch_add(1);
+        ::syscall(SYS_futex, FutexWord(), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+
+    void Run() {
+        for(;;) {
+            // read the futex word before the state, a Request after this
+            // point changes the word and the wait returns immediately
+            const uint32_t wakeups = wakeups_.load();
+            if(!running_) {
+                return;
+            }
+            if(state_.load() == kRequested) {
+                ready_ = pool_.PrepareBlock(requested_slots_);
+                state_.store(kReady, std::memory_order_release);
+                continue;
+            }
+            ::syscall(SYS_futex, FutexWord(), FUTEX_WAIT_PRIVATE, wakeups, nullptr, nullptr, 0);
+        }
+    }
+};
+
+#endif // BLOCKREFILL_H
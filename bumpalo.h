@@ -2,6 +2,44 @@
 #define BUMPALO_H
 
 #include "bumpalobase.h"
+#include "poolregistry.h"
+
+/// @brief BlockSource
+/// @details Hands prepared blocks to BumpAlo<T>::Allocate, so a burst does
+///          not have to request memory itself. See BlockRefill in 
+///          blockrefill.h, which prepares the blocks in a background thread.
+/// @tparam T
+template <class T>
+class BlockSource {
+
+    public:
+    using Block = typename BumpAloBase<T>::Block;
+
+    /// @brief Takes a prepared block over, never blocks
+    /// @return prepared block or nullptr if none is ready
+    virtual Block *Take() = 0;
+
+    /// @brief Asks for a block, never blocks
+    /// @param no_free_slots free slots left in the pool
+    virtual void Request(size_t no_free_slots) = 0;
+
+    /// @brief A block is requested if fewer slots are free
+    size_t GetLowWatermark() const {
+        return low_watermark_;
+    }
+
+    /// @brief A block refills the pool up to this number of free slots
+    size_t GetHighWatermark() const {
+        return high_watermark_;
+    }
+
+    protected:
+    BlockSource() : low_watermark_{0}, high_watermark_{0} {}
+    ~BlockSource() = default;
+
+    size_t low_watermark_;
+    size_t high_watermark_;
+};
 
 /// @brief BumpAlo 
 ///         
@@ -16,6 +54,9 @@
 ///        Only one slot can be handed back to the pool per deallocation.
 ///        The AddMemory function can be used pre-allocate memory. If the pool is 
 ///        exhausted Allocate will call AddMemory.
+///        With a BlockSource attached (see BlockRefill), Allocate takes 
+///        prepared blocks over once the free slots drop below a low 
+///        watermark, instead of calling AddMemory.
 ///                
 ///        Rationale: This allocator is to be used in conjunction with 
 ///                   std::map. This container serve the usecase to work with a 
@@ -24,6 +65,9 @@
 ///                   objects allocation demangs you are free to use it.  
 /// 
 ///                
+///        Every BumpAlo<T> registers itself in the PoolRegistry under 
+///        GetTypeKey<T>(), so tooling can list all pools by name.
+///
 ///        Dynamic memory, is a global resource. A object requests heap memory on initialisation 
 ///        and releases it on destruction. To keep the global character a thread safe singelton 
 ///        pattern is followed, allowing lazy initialization (Mayer's Singelton).
@@ -61,6 +105,9 @@ class BumpAlo {
     /// @param no_slots 
     /// @return pointer to free slot  
     T *Allocate(size_t no_slots = 1) {
+        if(source_ != nullptr) {
+            return AllocateFromSource(no_slots);
+        }
         if(base_.GetNoOfBlocks() == 0) {
             base_.AddMemory(1);
         } else if(base_.IsEndOfBlock()) {
@@ -78,6 +125,36 @@ class BumpAlo {
     }
 
 
+    /// @brief Switches the pool to guard mode
+    /// @details Hardens the free list and detects double frees and use 
+    ///          after free of slots. Has to be called before memory is added.
+    void EnableGuard() {
+        base_.EnableGuard();
+    }
+
+    /// @brief Lets Allocate take blocks over from source
+    /// @details Once fewer than source->GetLowWatermark() slots are free, 
+    ///          Allocate requests a block from source and adopts it as soon
+    ///          as it is ready. nullptr detaches the source.
+    /// @param source 
+    void SetBlockSource(BlockSource<T> *source) {
+        source_ = source;
+    }
+
+    /// @brief Prepares a block for AdoptBlock, see BumpAloBase<T>::PrepareBlock
+    /// @details May be called from another thread.
+    /// @param no_slots 
+    /// @return prepared block
+    typename BumpAloBase<T>::Block *PrepareBlock(size_t no_slots) const {
+        return base_.PrepareBlock(no_slots);
+    }
+
+    /// @brief Releases a prepared block that was never adopted
+    /// @param block 
+    void DiscardBlock(typename BumpAloBase<T>::Block *block) const {
+        base_.DiscardBlock(block);
+    }
+
     /// @brief GetSizeOfType
     /// @return size of type
     size_t GetSizeOfType() {
@@ -96,15 +173,30 @@ class BumpAlo {
         return base_.GetNoOfBlocks();
     }
 
+    /// @brief GetNoOfFreeSlots
+    /// @return number of slots in pool which are not handed out
+    size_t GetNoOfFreeSlots() {
+        return base_.GetNoOfFreeSlots();
+    }
+
+    /// @brief Releases every block whose slots are all free back to the OS
+    /// @return number of released blocks
+    size_t ReleaseFreeBlocks() {
+        return base_.ReleaseFreeBlocks();
+    }
+
 private:
 
-    BumpAlo() { 
+    BumpAlo() : source_{nullptr} { 
+        // a full registry counts the pool as dropped, the pool itself works
+        PoolRegistry::Get().Register(GetTypeKey<T>(), GetTypeId<T>(), GetTypeNameView<T>(), this, &Inspect);
 #ifdef DEBUG_BUMPALO
            std::cout << __FUNCTION__ << std::endl;
 #endif
     }
 
     ~BumpAlo() {
+        PoolRegistry::Get().Unregister(this);
 
 #ifdef DEBUG_BUMPALO
         std::cout << __FUNCTION__  << std::endl;
@@ -115,6 +207,29 @@ private:
     BumpAlo& operator=(const BumpAlo&)= delete;
 
     BumpAloBase<T> base_;
+    BlockSource<T> *source_;
+
+    static PoolInfo Inspect(const void *pool) {
+        auto &base = const_cast<BumpAlo *>(static_cast<const BumpAlo *>(pool))->base_;
+        return PoolInfo{GetTypeNameView<T>(), GetTypeId<T>(), base.GetSizeOfType(),
+                        base.GetSizeOfPool(), base.GetNoOfBlocks(), base.GetNoOfFreeSlots()};
+    }
+
+    T *AllocateFromSource(size_t no_slots) {
+        // cheap handoff of a prepared block
+        if(auto block = source_->Take()) {
+            base_.AdoptBlock(block);
+        }
+        // the burst was faster than the source
+        if(base_.GetNoOfBlocks() == 0 || base_.IsEndOfBlock()) {
+            base_.AddMemory(source_->GetHighWatermark());
+        }
+        T *slot = base_.Allocate(no_slots);
+        if(base_.GetNoOfFreeSlots() < source_->GetLowWatermark()) {
+            source_->Request(base_.GetNoOfFreeSlots());
+        }
+        return slot;
+    }
   
 };
 
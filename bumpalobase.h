@@ -1,28 +1,88 @@
 #ifndef BUMPALOBASE_H
 #define BUMPALOBASE_H
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <iostream>
 #include <vector>
 #include "typename.h"
 #include "dynamicbuffer.h"
 
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define BUMPALOBASE_ASAN
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+#define BUMPALOBASE_ASAN
+#endif
+
+#ifdef BUMPALOBASE_ASAN
+#include <sanitizer/asan_interface.h>
+#define BUMPALOBASE_POISON(addr, size) ASAN_POISON_MEMORY_REGION(addr, size)
+#define BUMPALOBASE_UNPOISON(addr, size) ASAN_UNPOISON_MEMORY_REGION(addr, size)
+#else
+#define BUMPALOBASE_POISON(addr, size) ((void)(addr), (void)(size))
+#define BUMPALOBASE_UNPOISON(addr, size) ((void)(addr), (void)(size))
+#endif
+
+/// @brief BumpAloBase
+///
+/// @details
+///
+///        block : [header][allocated bitmap, guard only][slot][slot]...[slot]
+///
+///        Guard mode (EnableGuard) hardens the pool against use after free
+///        and double free:
+///          - the next pointer of a free slot is stored XORed with a per 
+///            pool secret and the slot's address and is checked on Allocate
+///          - the rest of a free slot holds canaries, which Deallocate 
+///            writes and Allocate checks
+///          - a bitmap per block marks the handed out slots, Deallocate of a
+///            free slot or of a foreign pointer aborts
+///          - free slots are poisoned if built with AddressSanitizer
+///        Without guard mode each of these costs one predictable branch.
+///
+///        Guarded blocks start at a multiple of kGuardSpan and are at most 
+///        kGuardSpan bytes long, larger requests are split into several
+///        blocks. Masking a slot's address gives the start of its block,
+///        which is looked up in a fixed hash table chained through the 
+///        block headers. Finding the block of a slot takes constant time
+///        and adopting a block does not allocate.
+///
+/// @tparam T
 template <class T>
 class BumpAloBase {
 
 public:
 
+    /// @brief Header in front of the slots of every block of the pool
+    /// @details Blocks are chained through the header, so a block prepared 
+    ///          elsewhere can be handed to the pool without any allocation.
+    struct Block {
+        Block *next;
+        size_t no_slots;
+        char *slots;
+        uint64_t *allocated;    // guard mode only, one bit per slot
+        Block *guard_next;      // guard mode only, next block in the same hash bucket
+    };
+
 #ifdef DEBUG_BUMPALOBASE
-    BumpAloBase() :  no_slots_{0},  no_blocks_{0}, block_size_{1}, alloc_ptr_{nullptr}, block_end_{nullptr}, type_name_{GetTypeName<T>()} { 
+    BumpAloBase() :  no_slots_{0},  no_blocks_{0}, no_free_slots_{0}, block_size_{1}, alloc_ptr_{nullptr}, blocks_{nullptr}, guard_{false}, secret_{0}, guard_table_{nullptr}, type_name_{GetTypeNameView<T>()} { 
            std::cout << __FUNCTION__ << "<" << type_name_<< ">" << std::endl;
     }
 #else
-     BumpAloBase() :  no_slots_{0},  no_blocks_{0}, block_size_{1}, alloc_ptr_{nullptr}, block_end_{nullptr} {}
+     BumpAloBase() :  no_slots_{0},  no_blocks_{0}, no_free_slots_{0}, block_size_{1}, alloc_ptr_{nullptr}, blocks_{nullptr}, guard_{false}, secret_{0}, guard_table_{nullptr} {}
 #endif
 
     ~BumpAloBase() {
-        for(auto ptr : ptr_to_free_) {
-            ::operator delete(ptr);
-        }
+        DiscardBlock(blocks_);
+        std::free(guard_table_);
 
 #ifdef DEBUG_BUMPALOBASE
         std::cout << __FUNCTION__ << "<" << type_name_<< ">" << std::endl;
@@ -32,33 +92,170 @@ public:
     BumpAloBase(const BumpAloBase&)= delete;
     BumpAloBase& operator=(const BumpAloBase&)= delete;
 
+    /// @brief Switches the pool to guard mode
+    /// @details Has to be called before memory is added to the pool.
+    void EnableGuard() {
+        if(no_blocks_ != 0) {
+            std::cerr << __FUNCTION__ << " pool has already been created\n";
+            std::abort();
+        }
+        if(guard_) {
+            return;
+        }
+        guard_table_ = static_cast<Block **>(std::calloc(kGuardTableSize, sizeof(Block *)));
+        if(guard_table_ == nullptr) {
+            std::cerr << __FUNCTION__ << " bad alloc\n";
+            std::abort();
+        }
+        // no std::random_device, it may allocate
+        uint64_t seed = reinterpret_cast<uintptr_t>(this) ^
+                        static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+        // splitmix64
+        seed += 0x9E3779B97F4A7C15ull;
+        seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+        seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBull;
+        secret_ = static_cast<uintptr_t>(seed ^ (seed >> 31));
+        guard_ = true;
+    }
+
+    bool IsGuarded() {
+        return guard_;
+    }
+
+    /// @brief Adds a new block of no_slots slots in front of the free slots
+    /// @param no_slots 
     void AddMemory(size_t no_slots = 1) {
+        AdoptBlock(AddMemoryImpl(no_slots));
+    }
 
-            Slot * block_begin = AddMemoryImpl(no_slots);
+    /// @brief Requests and prepares a block of no_slots slots
+    /// @details The block is prefaulted and its slots are linked, but it is 
+    ///          not part of the pool until it is handed to AdoptBlock. 
+    ///          PrepareBlock does not modify the pool and may be called from
+    ///          another thread. The memory comes from posix_memalign, not 
+    ///          from ::operator new, so a block can be prepared while SafAlo
+    ///          prohibits allocations. In guard mode more than 
+    ///          kGuardMaxSlots slots are split into a chain of blocks.
+    /// @param no_slots 
+    /// @return prepared block
+    Block *PrepareBlock(size_t no_slots) const {
+        if(no_slots <= 0) {
+            std::cerr << __FUNCTION__ << " no_slots : " << no_slots << " is not possible\n";
+            std::abort();
+        }
+        if(!guard_) {
+            return PrepareOneBlock(no_slots);
+        }
+        Block *chain = nullptr;
+        while(no_slots > 0) {
+            const size_t block_slots = std::min(no_slots, size_t{kGuardMaxSlots});
+            Block *block = PrepareOneBlock(block_slots);
+            block->next = chain;
+            chain = block;
+            no_slots -= block_slots;
+        }
+        return chain;
+    }
 
-            // first block of the pool 
-            // allocation ptr is set to block begin
-            if(no_blocks_== 0) {
-                alloc_ptr_ = block_begin;
-            }
+    /// @brief Hands a prepared block to the pool
+    /// @details The slots of the block are put in front of the free slots. 
+    ///          Neither memory is requested from the OS nor is anything
+    ///          allocated.
+    /// @param block returned by PrepareBlock, including the blocks chained behind it
+    void AdoptBlock(Block *block) {
+        while(block != nullptr) {
+            Block *next = block->next;
+            AdoptOneBlock(block);
+            block = next;
+        }
+    }
 
-            // pool is exhauseted new memory is added to the 
-            // allocation ptr is set to block begin  
-            if(alloc_ptr_ == nullptr) {
-                alloc_ptr_ = block_begin;
+    /// @brief Releases a prepared block that was never adopted
+    /// @param block returned by PrepareBlock, including the blocks chained behind it
+    void DiscardBlock(Block *block) const {
+        while(block != nullptr) {
+            Block *next = block->next;
+            if(guard_) {
+                BUMPALOBASE_UNPOISON(block->slots, block->no_slots*sizeof(T));
             }
+            std::free(block);
+            block = next;
+        }
+    }
 
-            // every call to AddMemory adds a new block of size no_slots
-            ++no_blocks_;
-            no_slots_ += no_slots;
-            block_size_ = no_slots;
+    /// @brief Releases every block whose slots are all free back to the OS
+    /// @details Walks the free slots once and drops the ones of released 
+    ///          blocks, the order of the remaining free slots is kept.
+    ///          Not meant for the hot path, the bookkeeping allocates.
+    /// @return number of released blocks
+    size_t ReleaseFreeBlocks() {
+        if(no_free_slots_ == 0) {
+            return 0;
+        }
 
-            // storing block_begin
-            // to release the memory back to the OS
-            // the the end of the programm
-            ptr_to_free_.push_back(static_cast<void*>(block_begin));
-    }
+        // blocks sorted by address, to look up the block of a slot
+        std::vector<Block *> blocks;
+        blocks.reserve(no_blocks_);
+        for(Block *block = blocks_; block != nullptr; block = block->next) {
+            blocks.push_back(block);
+        }
+        std::sort(blocks.begin(), blocks.end(), std::less<Block *>());
+
+        auto block_index = [&blocks](const void *ptr) {
+            auto it = std::upper_bound(blocks.begin(), blocks.end(), ptr, [](const void *p, Block *block) {
+                return std::less<const void *>()(p, block);
+            });
+            return static_cast<size_t>(it - blocks.begin()) - 1;
+        };
+
+        std::vector<size_t> no_free(blocks.size(), 0);
+        for(Slot *slot = alloc_ptr_; slot != nullptr; slot = Next(slot)) {
+            ++no_free[block_index(slot)];
+        }
+        auto is_released = [&](const void *ptr) {
+            size_t i = block_index(ptr);
+            return no_free[i] == blocks[i]->no_slots;
+        };
+
+        // unlink the free slots of released blocks
+        Slot *prev = nullptr;
+        for(Slot *slot = alloc_ptr_; slot != nullptr; ) {
+            Slot *next = Next(slot);
+            if(!is_released(slot)) {
+                prev = slot;
+            } else if(prev == nullptr) {
+                alloc_ptr_ = next;
+            } else {
+                SetNext(prev, next);
+            }
+            slot = next;
+        }
 
+        size_t no_released = 0;
+        Block **block_link = &blocks_;
+        while(*block_link != nullptr) {
+            Block *block = *block_link;
+            if(is_released(block)) {
+                *block_link = block->next;
+                --no_blocks_;
+                no_slots_ -= block->no_slots;
+                no_free_slots_ -= block->no_slots;
+                if(guard_) {
+                    Block **bucket_link = &guard_table_[GuardBucket(block)];
+                    while(*bucket_link != block) {
+                        bucket_link = &(*bucket_link)->guard_next;
+                    }
+                    *bucket_link = block->guard_next;
+                }
+                block->next = nullptr;
+                DiscardBlock(block);
+                ++no_released;
+            } else {
+                block_link = &block->next;
+            }
+        }
+        return no_released;
+    }
       
     /// @brief Hands out one slot per allocation
     /// @details If this function is used otherwise, the program will be aborted
@@ -79,7 +276,12 @@ public:
             std::abort();
         } 
         Slot *free_slot = alloc_ptr_;
-        alloc_ptr_ = alloc_ptr_->next;
+        if(guard_) {
+            alloc_ptr_ = GuardedPop(free_slot);
+        } else {
+            alloc_ptr_ = alloc_ptr_->next;
+        }
+        --no_free_slots_;
                 
 #ifdef DEBUG_BUMPALOBASE
             std::cout << __FUNCTION__ << "<" << type_name_<< "> \n      free_slot @" << free_slot << std::endl;
@@ -97,9 +299,14 @@ public:
             std::cerr << __FUNCTION__ << " can hand back only one slot per deallocation\n";
             std::abort();
         }
-        new (slot) Slot(); // deleting slot's content 
-        reinterpret_cast<Slot *>(slot)->next = alloc_ptr_;
+        if(guard_) {
+            GuardedPush(reinterpret_cast<Slot *>(slot));
+        } else {
+            new (slot) Slot(); // deleting slot's content 
+            reinterpret_cast<Slot *>(slot)->next = alloc_ptr_;
+        }
         alloc_ptr_ = reinterpret_cast<Slot *>(slot);
+        ++no_free_slots_;
 
 #ifdef DEBUG_BUMPALOBASE
             std::cout << __FUNCTION__ << "<" << type_name_<< "> \n      deleted @" << slot << std::endl;
@@ -124,6 +331,12 @@ public:
     size_t GetNoOfBlocks() {
         return no_blocks_;
     }
+
+    /// @brief GetNoOfFreeSlots
+    /// @return number of slots in pool which are not handed out
+    size_t GetNoOfFreeSlots() {
+        return no_free_slots_;
+    }
     
     bool IsEndOfBlock() {
         if(no_blocks_ == 0) {
@@ -140,66 +353,232 @@ private:
         Slot *next;
     };
 
+    // C++14 has no aligned new, posix_memalign needs a multiple of sizeof(void *)
+    static constexpr size_t kBlockAlignment = std::max(alignof(T), std::max(alignof(Block), sizeof(void *)));
+    // slots start behind the block header, aligned for T
+    static constexpr size_t kBlockHeaderSize = (sizeof(Block) + alignof(T) - 1) / alignof(T) * alignof(T);
+    static constexpr size_t NextPowerOfTwo(size_t n) {
+        size_t p = 1;
+        while(p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    // guarded blocks are aligned to and fit into kGuardSpan bytes, at least one slot fits
+    static constexpr size_t kGuardSpan = std::max<size_t>(size_t{64} * 1024,
+        NextPowerOfTwo(kBlockHeaderSize + sizeof(uint64_t) + alignof(T) + sizeof(T)));
+    static constexpr size_t kGuardHeaderSize = (kBlockHeaderSize + (kGuardSpan / sizeof(T) + 63) / 64 * sizeof(uint64_t)
+                                                + alignof(T) - 1) / alignof(T) * alignof(T);
+    static constexpr size_t kGuardMaxSlots = (kGuardSpan - kGuardHeaderSize) / sizeof(T);
+    // buckets of the guarded blocks, allocated by EnableGuard
+    static constexpr size_t kGuardTableSize = 1024;
+    // guard mode checks at most this many canary words behind the next pointer
+    static constexpr size_t kCanaryWords = std::min<size_t>(sizeof(T) / sizeof(uint64_t) - 1, 7);
+
     size_t no_slots_;
     size_t no_blocks_;
+    size_t no_free_slots_;
     size_t block_size_;
     Slot *alloc_ptr_;
-    Slot *block_end_;
+    Block *blocks_;
+    bool guard_;
+    uintptr_t secret_;
+    Block **guard_table_;               // guard mode only, kGuardTableSize buckets
     DynamicBuffer<Slot> dm_;
 #ifdef DEBUG_BUMPALOBASE
-    const std::string type_name_;
+    const TypeNameView type_name_;
 #endif
-    std::vector<void*> ptr_to_free_;
 
     static_assert(sizeof(T) >= 8, "Smaller types are not supported");
+    static_assert(kGuardMaxSlots >= 1, "no slot fits into a guarded block");
 
 
-    Slot * AddMemoryImpl(size_t block_size) {
-        if(block_size <= 0) {
-            std::cerr << __FUNCTION__ << " block_size : " << block_size << " is not possible\n";
-            std::abort();
+    static Slot *FirstSlot(Block *block) {
+        return reinterpret_cast<Slot *>(block->slots);
+    }
+
+    Slot *Next(Slot *slot) const {
+        if(!guard_) {
+            return slot->next;
+        }
+        BUMPALOBASE_UNPOISON(slot, sizeof(Slot *));
+        uintptr_t encoded = reinterpret_cast<uintptr_t>(slot->next);
+        BUMPALOBASE_POISON(slot, sizeof(Slot *));
+        return reinterpret_cast<Slot *>(encoded ^ secret_ ^ reinterpret_cast<uintptr_t>(slot));
+    }
+
+    // in guard mode also writes the canaries and poisons the slot
+    void SetNext(Slot *slot, Slot *next) const {
+        if(!guard_) {
+            slot->next = next;
+            return;
         }
+        BUMPALOBASE_UNPOISON(slot, sizeof(T));
+        const uintptr_t address = reinterpret_cast<uintptr_t>(slot);
+        slot->next = reinterpret_cast<Slot *>(reinterpret_cast<uintptr_t>(next) ^ secret_ ^ address);
+        const uint64_t canary = Canary(slot);
+        for(size_t i = 1; i <= kCanaryWords; ++i) {
+            std::memcpy(reinterpret_cast<char *>(slot) + i*sizeof(uint64_t), &canary, sizeof(canary));
+        }
+        BUMPALOBASE_POISON(slot, sizeof(T));
+    }
 
-        auto last_index = dm_.GetLast();        
+    uint64_t Canary(const Slot *slot) const {
+        return ~static_cast<uint64_t>(secret_ ^ reinterpret_cast<uintptr_t>(slot)) * 0x9E3779B97F4A7C15ull;
+    }
 
-        dm_.Add(block_size);
+    static size_t GuardBucket(const void *block) {
+        return static_cast<size_t>((reinterpret_cast<uintptr_t>(block) / kGuardSpan) * 0x9E3779B97F4A7C15ull
+                                   >> 32) % kGuardTableSize;
+    }
 
-        for (size_t i = last_index; i < dm_.GetCapacity(); ++i) {
-            dm_[i].next = &dm_[i]+ sizeof(T);  
+    // block holding slot, nullptr if slot is not the start of a slot of this pool
+    Block *FindBlock(const void *slot, size_t &index) const {
+        // the block starts at the span of slot, it is only dereferenced
+        // once it is found in the table
+        const void *start = reinterpret_cast<const void *>(reinterpret_cast<uintptr_t>(slot) & ~(uintptr_t{kGuardSpan} - 1));
+        Block *block = guard_table_[GuardBucket(start)];
+        while(block != nullptr && block != start) {
+            block = block->guard_next;
         }
+        if(block == nullptr) {
+            return nullptr;
+        }
+        const char *ptr = static_cast<const char *>(slot);
+        if(std::less<const char *>()(ptr, block->slots)) {
+            return nullptr;
+        }
+        const size_t offset = static_cast<size_t>(ptr - block->slots);
+        index = offset / sizeof(T);
+        if(offset % sizeof(T) != 0 || index >= block->no_slots) {
+            return nullptr;
+        }
+        return block;
+    }
 
-        dm_[dm_.GetLast()].next = nullptr;
-
+    Slot *GuardedPop(Slot *slot) {
+        size_t index = 0;
+        Block *block = FindBlock(slot, index);
+        if(block == nullptr || (block->allocated[index / 64] >> (index % 64) & 1) != 0) {
+            std::cerr << __FUNCTION__ << " free list corrupted at @" << slot << "\n";
+            std::abort();
+        }
+        BUMPALOBASE_UNPOISON(slot, sizeof(T));
+        const uint64_t canary = Canary(slot);
+        for(size_t i = 1; i <= kCanaryWords; ++i) {
+            uint64_t word;
+            std::memcpy(&word, reinterpret_cast<char *>(slot) + i*sizeof(uint64_t), sizeof(word));
+            if(word != canary) {
+                std::cerr << __FUNCTION__ << " use after free of slot @" << slot << "\n";
+                std::abort();
+            }
+        }
+        Slot *next = reinterpret_cast<Slot *>(reinterpret_cast<uintptr_t>(slot->next) ^ secret_ ^ reinterpret_cast<uintptr_t>(slot));
+        block->allocated[index / 64] |= uint64_t{1} << (index % 64);
+        return next;
+    }
 
-        for (size_t i = 0; i < dm_.GetCapacity(); ++i) {
-            std::cout << i << " " <<dm_[i].next << std::endl;
+    void GuardedPush(Slot *slot) {
+        size_t index = 0;
+        Block *block = FindBlock(slot, index);
+        if(block == nullptr) {
+            std::cerr << __FUNCTION__ << " slot @" << slot << " does not belong to the pool\n";
+            std::abort();
         }
+        if((block->allocated[index / 64] >> (index % 64) & 1) == 0) {
+            std::cerr << __FUNCTION__ << " double free of slot @" << slot << "\n";
+            std::abort();
+        }
+        block->allocated[index / 64] &= ~(uint64_t{1} << (index % 64));
+        SetNext(slot, alloc_ptr_);
+    }
 
+    Block *PrepareOneBlock(size_t no_slots) const {
+        // the bitmap of handed out slots sits between header and slots
+        const size_t bitmap_bytes = guard_ ? (no_slots + 63) / 64 * sizeof(uint64_t) : 0;
+        const size_t header_bytes = (kBlockHeaderSize + bitmap_bytes + alignof(T) - 1) / alignof(T) * alignof(T);
+
+        // request memory from OS, aligned for over aligned types as well
+        const size_t block_bytes = header_bytes + no_slots*sizeof(T);
+        void *memory = nullptr;
+        if(posix_memalign(&memory, guard_ ? size_t{kGuardSpan} : size_t{kBlockAlignment}, block_bytes) != 0) {
+            std::cerr << __FUNCTION__ << " bad alloc\n";
+            std::abort();
+        }
+        Block *block = static_cast<Block *>(memory);
+        // touch every page now, not on first use of a slot
+        std::memset(static_cast<void *>(block), 0, block_bytes);
+        block->next = nullptr;
+        block->guard_next = nullptr;
+        block->no_slots = no_slots;
+        block->slots = reinterpret_cast<char *>(block) + header_bytes;
+        block->allocated = guard_ ? reinterpret_cast<uint64_t *>(reinterpret_cast<char *>(block) + kBlockHeaderSize) : nullptr;
 
-        // request memeory from OS
-        Slot *block_begin = reinterpret_cast<Slot *>(::operator new(block_size*sizeof(T)));
         // start of block 
-        Slot *slot = block_begin;
+        Slot *slot = FirstSlot(block);
 
         // crate slots
-        for (size_t i = 0; i < block_size - 1; ++i) {
-            slot->next =  reinterpret_cast<Slot *>(reinterpret_cast<char *>(slot) + sizeof(T));
-            slot = slot->next;
-           
+        for (size_t i = 0; i < no_slots - 1; ++i) {
+            Slot *next = reinterpret_cast<Slot *>(reinterpret_cast<char *>(slot) + sizeof(T));
+            SetNext(slot, next);
+            slot = next;
+        }
+
+        // last slot of block
+        SetNext(slot, nullptr);
+
+        return block;
+    }
+
+    void AdoptOneBlock(Block *block) {
+        Slot *first = FirstSlot(block);
+        Slot *last = reinterpret_cast<Slot *>(reinterpret_cast<char *>(first) + (block->no_slots - 1)*sizeof(T));
+        SetNext(last, alloc_ptr_);
+        alloc_ptr_ = first;
+
+        if(guard_) {
+            Block *&bucket = guard_table_[GuardBucket(block)];
+            block->guard_next = bucket;
+            bucket = block;
         }
 
-        // last slot of pool
-        slot->next = nullptr;
+        // storing the block
+        // to release the memory back to the OS
+        // the the end of the programm
+        block->next = blocks_;
+        blocks_ = block;
+
+        // every adopted block is a new block of size no_slots
+        ++no_blocks_;
+        no_slots_ += block->no_slots;
+        no_free_slots_ += block->no_slots;
+        block_size_ = block->no_slots;
+    }
 
-        // connect blocks, if pool is not exhausted already 
-        if(alloc_ptr_ != nullptr) {
-            block_end_->next =  reinterpret_cast<Slot *>(block_begin);
-        }   
+    Block * AddMemoryImpl(size_t block_size) {
+        if(block_size <= 0) {
+            std::cerr << __FUNCTION__ << " block_size : " << block_size << " is not possible\n";
+            std::abort();
+        }
 
+        auto last_index = dm_.GetLast();        
 
-        block_end_ = slot;
+        dm_.Add(block_size);
+
+        for (size_t i = last_index; i < dm_.GetCapacity(); ++i) {
+            dm_[i].next = &dm_[i]+ sizeof(T);  
+        }
+
+        dm_[dm_.GetLast()].next = nullptr;
+
+#ifdef DEBUG_BUMPALOBASE
+        for (size_t i = 0; i < dm_.GetCapacity(); ++i) {
+            std::cout << i << " " <<dm_[i].next << std::endl;
+        }
+#endif
 
-        return block_begin;
+        return PrepareBlock(block_size);
     }       
 };
 
@@ -0,0 +1,144 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include <map>
+#include <set>
+#include <utility>
+#include "palo.h"
+#include "pooledbtreemap.h"
+
+/// @brief CompactTraits
+/// @details Tells MapCompactor which pools hold the nodes of a container.
+///          The default covers std::map and std::set with PAlo, whose nodes
+///          are GCC's std::_Rb_tree_node<value_type>.
+/// @tparam Container
+template <class Container>
+struct CompactTraits {
+    using Node = std::_Rb_tree_node<typename Container::value_type>;
+
+    /// @brief Puts a fresh block of no_nodes slots in front of the pool
+    static void ReservePool(size_t no_nodes) {
+        BumpAlo<Node>::Get().AddMemory(no_nodes);
+    }
+
+    static size_t ReleasePoolBlocks() {
+        return BumpAlo<Node>::Get().ReleaseFreeBlocks();
+    }
+};
+
+template <class Key, class T, class Compare, size_t NodeBytes>
+struct CompactTraits<PooledBTreeMap<Key, T, Compare, NodeBytes>> {
+    using Map = PooledBTreeMap<Key, T, Compare, NodeBytes>;
+
+    static void ReservePool(size_t no_values) {
+        Map::ReservePool(no_values);
+    }
+
+    static size_t ReleasePoolBlocks() {
+        return Map::ReleasePoolBlocks();
+    }
+};
+
+
+/// @brief MapCompactor
+///
+/// @details
+///
+///        Rebuilds a pooled node container into fresh, contiguous slots
+///        in key order and releases the blocks left empty afterwards.
+///
+///        copy    : values are inserted in order into a new container,
+///                  whose nodes come from a fresh block in front of the pool
+///        swap    : the new container replaces the old one
+///        drain   : the old nodes are handed back to the pool
+///        release : blocks without used slots go back to the OS
+///
+///        Every call to Step does at most max_nodes nodes of work, so the
+///        pause per call is bounded. Between steps the container can be
+///        read, but it must not be modified until Step returns true.
+///
+/// @attention
+///
+///        Modifications between steps are not detected. A value changed
+///        behind the copy position is lost, an insert or erase invalidates
+///        the copy position of a PooledBTreeMap and is undefined behaviour.
+///        While the compaction is in progress, other containers using the
+///        same pool can take slots of the fresh block. Peak memory is twice
+///        the container's nodes.
+///
+/// @tparam Container std::map, std::set with PAlo or PooledBTreeMap
+template <class Container>
+class MapCompactor {
+
+public:
+    /// @param container to compact
+    /// @param move_values move instead of copy the values, only if the
+    ///        container is not read between steps
+    explicit MapCompactor(Container &container, bool move_values = false) :
+        container_(container), fresh_(container.key_comp()), pos_{container.begin()},
+        move_values_{move_values}, phase_{kCopy} {
+        if(!container.empty()) {
+            CompactTraits<Container>::ReservePool(container.size());
+        }
+    }
+
+    MapCompactor(const MapCompactor&)= delete;
+    MapCompactor& operator=(const MapCompactor&)= delete;
+
+    /// @brief Does at most max_nodes nodes of work
+    /// @return true if the compaction is complete
+    bool Step(size_t max_nodes) {
+        if(phase_ == kCopy) {
+            for(; max_nodes > 0 && pos_ != container_.end(); --max_nodes, ++pos_) {
+                if(move_values_) {
+                    fresh_.emplace_hint(fresh_.end(), std::move(*pos_));
+                } else {
+                    fresh_.emplace_hint(fresh_.end(), *pos_);
+                }
+            }
+            if(pos_ == container_.end()) {
+                container_.swap(fresh_);
+                phase_ = kDrain;
+            }
+        }
+        if(phase_ == kDrain) {
+            // fresh_ holds the old nodes now
+            for(; max_nodes > 0 && !fresh_.empty(); --max_nodes) {
+                fresh_.erase(fresh_.begin());
+            }
+            if(fresh_.empty()) {
+                CompactTraits<Container>::ReleasePoolBlocks();
+                phase_ = kDone;
+            }
+        }
+        return phase_ == kDone;
+    }
+
+    bool IsDone() const {
+        return phase_ == kDone;
+    }
+
+private:
+    enum Phase { kCopy, kDrain, kDone };
+
+    Container &container_;
+    Container fresh_;
+    typename Container::iterator pos_;
+    bool move_values_;
+    Phase phase_;
+};
+
+
+/// @brief Rebuilds container into contiguous slots in key order
+/// @details Releases the pool blocks which are left without used slots.
+///          Pauses for the whole container, use MapCompactor to bound
+///          the pause.
+/// @tparam Container std::map, std::set with PAlo or PooledBTreeMap
+template <class Container>
+void Compact(Container &container) {
+    MapCompactor<Container> compactor(container, true);
+    while(!compactor.Step(static_cast<size_t>(-1))) {
+    }
+}
+
+#endif // COMPACT_H
@@ -0,0 +1,927 @@
+#ifndef POOLEDBTREEMAP_H
+#define POOLEDBTREEMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "bumpalo.h"
+
+/// @brief CacheLinePadded
+/// @details Aligns N to the cache line and pads it up to a multiple of the
+///          cache line size, so slots of a BumpAlo<CacheLinePadded<N>> pool
+///          start on a cache line and never share one.
+template <class N>
+struct alignas(64) CacheLinePadded : N {};
+
+
+/// @brief PooledBTreeMap
+///
+/// @details
+///
+///        B-tree with a std::map interface. Every node holds up to kSlots
+///        values next to each other, so a lookup touches one or two cache
+///        lines per level instead of one node per key.
+///
+///        leaf node     : [parent|position|count][value][value]...[value]
+///        internal node : [leaf node][child][child]...[child]
+///
+///        Nodes are a multiple of the cache line size and are handed out by
+///        BumpAlo<LeafSlot> and BumpAlo<InternalSlot>. Keys inside a node are
+///        searched linearly.
+///
+/// @attention
+///
+///        Unlike std::map, insert and erase invalidate all iterators,
+///        references and pointers to values of the map.
+///
+/// @tparam Key
+/// @tparam T
+/// @tparam Compare
+/// @tparam NodeBytes targeted size of a leaf node in bytes
+template <class Key, class T, class Compare = std::less<Key>, size_t NodeBytes = 256>
+class PooledBTreeMap {
+
+public:
+    typedef Key                         key_type;
+    typedef T                           mapped_type;
+    typedef std::pair<const Key, T>     value_type;
+    typedef size_t                      size_type;
+    typedef ptrdiff_t                   difference_type;
+    typedef Compare                     key_compare;
+    typedef value_type&                 reference;
+    typedef const value_type&           const_reference;
+    typedef value_type*                 pointer;
+    typedef const value_type*           const_pointer;
+
+private:
+
+    // the node header takes at most two words
+    static constexpr size_t kSlots = (NodeBytes - 2*sizeof(void*)) / sizeof(value_type) < 3 ?
+                                     3 : (NodeBytes - 2*sizeof(void*)) / sizeof(value_type);
+    // every node but the root holds at least kMinSlots values
+    static constexpr size_t kMinSlots = kSlots / 2;
+
+    static_assert(kSlots <= UINT16_MAX, "NodeBytes is too large for value_type");
+
+    struct InternalNode;
+
+    struct LeafNode {
+        InternalNode *parent;
+        uint16_t position;  // index of this node in parent->children
+        uint16_t count;     // number of values in this node
+        bool leaf;
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type slots[kSlots];
+
+        value_type *slot(size_t i) {
+            return reinterpret_cast<value_type *>(&slots[i]);
+        }
+    };
+
+    struct InternalNode : LeafNode {
+        LeafNode *children[kSlots + 1];
+    };
+
+    using LeafSlot = CacheLinePadded<LeafNode>;
+    using InternalSlot = CacheLinePadded<InternalNode>;
+
+    static_assert(sizeof(LeafSlot) % 64 == 0, "leaf nodes are not cache line multiples");
+    static_assert(sizeof(InternalSlot) % 64 == 0, "internal nodes are not cache line multiples");
+    static_assert(alignof(LeafSlot) == 64 && alignof(InternalSlot) == 64, "nodes do not start on a cache line");
+
+
+    template <bool Const>
+    class Iterator {
+        friend class PooledBTreeMap;
+        template <bool> friend class Iterator;
+
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef typename PooledBTreeMap::value_type value_type;
+        typedef typename PooledBTreeMap::difference_type difference_type;
+        typedef typename std::conditional<Const, const value_type&, value_type&>::type reference;
+        typedef typename std::conditional<Const, const value_type*, value_type*>::type pointer;
+
+        Iterator() : node_{nullptr}, position_{0} {}
+
+        // iterator converts to const_iterator
+        template <bool C, class = typename std::enable_if<Const && !C>::type>
+        Iterator(const Iterator<C> &other) : node_{other.node_}, position_{other.position_} {}
+
+        reference operator*() const {
+            return *node_->slot(position_);
+        }
+
+        pointer operator->() const {
+            return node_->slot(position_);
+        }
+
+        Iterator &operator++() {
+            Increment();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator tmp = *this;
+            Increment();
+            return tmp;
+        }
+
+        Iterator &operator--() {
+            Decrement();
+            return *this;
+        }
+
+        Iterator operator--(int) {
+            Iterator tmp = *this;
+            Decrement();
+            return tmp;
+        }
+
+        friend bool operator==(const Iterator &a, const Iterator &b) {
+            return a.node_ == b.node_ && a.position_ == b.position_;
+        }
+
+        friend bool operator!=(const Iterator &a, const Iterator &b) {
+            return !(a == b);
+        }
+
+    private:
+        Iterator(LeafNode *node, size_t position) : node_{node}, position_{position} {}
+
+        // end() is the position behind the last value of the root
+        void Increment() {
+            if(!node_->leaf) {
+                node_ = AsInternal(node_)->children[position_ + 1];
+                while(!node_->leaf) {
+                    node_ = AsInternal(node_)->children[0];
+                }
+                position_ = 0;
+                return;
+            }
+            ++position_;
+            while(position_ == node_->count && node_->parent != nullptr) {
+                position_ = node_->position;
+                node_ = node_->parent;
+            }
+        }
+
+        void Decrement() {
+            if(!node_->leaf) {
+                node_ = AsInternal(node_)->children[position_];
+                while(!node_->leaf) {
+                    node_ = AsInternal(node_)->children[node_->count];
+                }
+                position_ = node_->count - 1;
+                return;
+            }
+            if(position_ > 0) {
+                --position_;
+                return;
+            }
+            while(node_->parent != nullptr && node_->position == 0) {
+                node_ = node_->parent;
+            }
+            position_ = node_->position - 1;
+            node_ = node_->parent;
+        }
+
+        LeafNode *node_;
+        size_t position_;
+    };
+
+public:
+    typedef Iterator<false> iterator;
+    typedef Iterator<true>  const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+
+    PooledBTreeMap() : root_{nullptr}, size_{0}, comp_{} {}
+
+    explicit PooledBTreeMap(const Compare &comp) : root_{nullptr}, size_{0}, comp_{comp} {}
+
+    template <class InputIt>
+    PooledBTreeMap(InputIt first, InputIt last, const Compare &comp = Compare()) : PooledBTreeMap(comp) {
+        insert(first, last);
+    }
+
+    PooledBTreeMap(std::initializer_list<value_type> init, const Compare &comp = Compare()) : PooledBTreeMap(comp) {
+        insert(init.begin(), init.end());
+    }
+
+    PooledBTreeMap(const PooledBTreeMap &other) : PooledBTreeMap(other.comp_) {
+        insert(other.begin(), other.end());
+    }
+
+    PooledBTreeMap(PooledBTreeMap &&other) noexcept : root_{other.root_}, size_{other.size_}, comp_{other.comp_} {
+        other.root_ = nullptr;
+        other.size_ = 0;
+    }
+
+    ~PooledBTreeMap() {
+        clear();
+    }
+
+    PooledBTreeMap &operator=(PooledBTreeMap other) {
+        swap(other);
+        return *this;
+    }
+
+    /// @brief Pre-allocates pool memory for no_values values
+    /// @details Adds enough slots to the node pools, so no_values values
+    ///          can be inserted without requesting memory from the OS.
+    /// @param no_values
+    static void ReservePool(size_t no_values) {
+        const size_t no_leaves = no_values / kMinSlots + 1;
+        BumpAlo<LeafSlot>::Get().AddMemory(no_leaves);
+        BumpAlo<InternalSlot>::Get().AddMemory(no_leaves / kMinSlots + 1);
+    }
+
+    /// @brief Releases node pool blocks whose slots are all free
+    /// @return number of released blocks
+    static size_t ReleasePoolBlocks() {
+        return BumpAlo<LeafSlot>::Get().ReleaseFreeBlocks() + BumpAlo<InternalSlot>::Get().ReleaseFreeBlocks();
+    }
+
+    /// @brief GetSlotsPerNode
+    /// @return maximum number of values in a node
+    static constexpr size_t GetSlotsPerNode() {
+        return kSlots;
+    }
+
+
+    iterator begin() noexcept {
+        return iterator(LeftmostLeaf(), 0);
+    }
+
+    const_iterator begin() const noexcept {
+        return const_iterator(LeftmostLeaf(), 0);
+    }
+
+    const_iterator cbegin() const noexcept {
+        return begin();
+    }
+
+    iterator end() noexcept {
+        return iterator(root_, root_ ? root_->count : 0);
+    }
+
+    const_iterator end() const noexcept {
+        return const_iterator(root_, root_ ? root_->count : 0);
+    }
+
+    const_iterator cend() const noexcept {
+        return end();
+    }
+
+    reverse_iterator rbegin() noexcept {
+        return reverse_iterator(end());
+    }
+
+    const_reverse_iterator rbegin() const noexcept {
+        return const_reverse_iterator(end());
+    }
+
+    reverse_iterator rend() noexcept {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rend() const noexcept {
+        return const_reverse_iterator(begin());
+    }
+
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    size_type size() const noexcept {
+        return size_;
+    }
+
+    size_type max_size() const noexcept {
+        return size_type(~0) / sizeof(value_type);
+    }
+
+    key_compare key_comp() const {
+        return comp_;
+    }
+
+
+    T &operator[](const Key &key) {
+        return InsertUnique(key, std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>()).first->second;
+    }
+
+    T &operator[](Key &&key) {
+        return InsertUnique(key, std::piecewise_construct, std::forward_as_tuple(std::move(key)), std::tuple<>()).first->second;
+    }
+
+    T &at(const Key &key) {
+        iterator it = find(key);
+        if(it == end()) {
+            throw std::out_of_range("PooledBTreeMap::at");
+        }
+        return it->second;
+    }
+
+    const T &at(const Key &key) const {
+        const_iterator it = find(key);
+        if(it == end()) {
+            throw std::out_of_range("PooledBTreeMap::at");
+        }
+        return it->second;
+    }
+
+
+    std::pair<iterator, bool> insert(const value_type &value) {
+        return InsertUnique(value.first, value);
+    }
+
+    std::pair<iterator, bool> insert(value_type &&value) {
+        return InsertUnique(value.first, std::move(value));
+    }
+
+    template <class InputIt>
+    void insert(InputIt first, InputIt last) {
+        for(; first != last; ++first) {
+            insert(*first);
+        }
+    }
+
+    template <class... Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+        value_type value(std::forward<Args>(args)...);
+        return InsertUnique(value.first, std::move(value));
+    }
+
+    /// @brief Inserts value, appending is cheap if hint is end()
+    /// @details Values appended in ascending order fill the nodes up 
+    ///          instead of leaving them half full after a split.
+    iterator insert(const_iterator hint, const value_type &value) {
+        return emplace_hint(hint, value);
+    }
+
+    iterator insert(const_iterator hint, value_type &&value) {
+        return emplace_hint(hint, std::move(value));
+    }
+
+    template <class... Args>
+    iterator emplace_hint(const_iterator hint, Args&&... args) {
+        value_type value(std::forward<Args>(args)...);
+        if(hint == cend() && (root_ == nullptr || comp_(std::prev(cend())->first, value.first))) {
+            return AppendRight(std::move(value));
+        }
+        return InsertUnique(value.first, std::move(value)).first;
+    }
+
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(const Key &key, Args&&... args) {
+        return InsertUnique(key, std::piecewise_construct, std::forward_as_tuple(key),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    // key is only moved from once the value is constructed
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(Key &&key, Args&&... args) {
+        return InsertUnique(key, std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    /// @brief Inserts obj at key or assigns it to the value at key
+    /// @return iterator to the value, true if it was inserted
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(const Key &key, M &&obj) {
+        // try_emplace leaves obj alone if key is present
+        auto result = try_emplace(key, std::forward<M>(obj));
+        if(!result.second) {
+            result.first->second = std::forward<M>(obj);
+        }
+        return result;
+    }
+
+    template <class M>
+    std::pair<iterator, bool> insert_or_assign(Key &&key, M &&obj) {
+        auto result = try_emplace(std::move(key), std::forward<M>(obj));
+        if(!result.second) {
+            result.first->second = std::forward<M>(obj);
+        }
+        return result;
+    }
+
+    template <class M>
+    iterator insert_or_assign(const_iterator, const Key &key, M &&obj) {
+        return insert_or_assign(key, std::forward<M>(obj)).first;
+    }
+
+    template <class M>
+    iterator insert_or_assign(const_iterator, Key &&key, M &&obj) {
+        return insert_or_assign(std::move(key), std::forward<M>(obj)).first;
+    }
+
+    /// @brief Erases the value at pos
+    /// @return iterator to the value following the erased one
+    iterator erase(const_iterator pos) {
+        const_iterator next = pos;
+        ++next;
+        if(next == cend()) {
+            EraseImpl(pos.node_, pos.position_);
+            return end();
+        }
+        // values move while the tree is rebalanced
+        Key next_key = next->first;
+        EraseImpl(pos.node_, pos.position_);
+        return lower_bound(next_key);
+    }
+
+    iterator erase(iterator pos) {
+        return erase(const_iterator(pos));
+    }
+
+    /// @brief Erases the values in [first, last)
+    /// @return iterator to the value following the erased ones
+    iterator erase(const_iterator first, const_iterator last) {
+        if(first == cbegin() && last == cend()) {
+            clear();
+            return end();
+        }
+        // every erase invalidates last, the number of values to erase does not change
+        size_type n = static_cast<size_type>(std::distance(first, last));
+        iterator it(first.node_, first.position_);
+        for(; n > 0; --n) {
+            it = erase(it);
+        }
+        return it;
+    }
+
+    size_type erase(const Key &key) {
+        iterator it = find(key);
+        if(it == end()) {
+            return 0;
+        }
+        EraseImpl(it.node_, it.position_);
+        return 1;
+    }
+
+    void clear() noexcept {
+        if(root_ != nullptr) {
+            DeleteTree(root_);
+            root_ = nullptr;
+        }
+        size_ = 0;
+    }
+
+    void swap(PooledBTreeMap &other) noexcept {
+        std::swap(root_, other.root_);
+        std::swap(size_, other.size_);
+        std::swap(comp_, other.comp_);
+    }
+
+
+    iterator find(const Key &key) {
+        return FindImpl<iterator>(key);
+    }
+
+    const_iterator find(const Key &key) const {
+        return FindImpl<const_iterator>(key);
+    }
+
+    size_type count(const Key &key) const {
+        return find(key) == end() ? 0 : 1;
+    }
+
+    iterator lower_bound(const Key &key) {
+        return BoundImpl<iterator>(key, false);
+    }
+
+    const_iterator lower_bound(const Key &key) const {
+        return BoundImpl<const_iterator>(key, false);
+    }
+
+    iterator upper_bound(const Key &key) {
+        return BoundImpl<iterator>(key, true);
+    }
+
+    const_iterator upper_bound(const Key &key) const {
+        return BoundImpl<const_iterator>(key, true);
+    }
+
+    std::pair<iterator, iterator> equal_range(const Key &key) {
+        return {lower_bound(key), upper_bound(key)};
+    }
+
+    std::pair<const_iterator, const_iterator> equal_range(const Key &key) const {
+        return {lower_bound(key), upper_bound(key)};
+    }
+
+private:
+
+    LeafNode *root_;
+    size_t size_;
+    Compare comp_;
+
+
+    static InternalNode *AsInternal(LeafNode *node) {
+        return static_cast<InternalNode *>(node);
+    }
+
+    static LeafNode *NewNode(bool leaf) {
+        LeafNode *node;
+        if(leaf) {
+            node = ::new (static_cast<void *>(BumpAlo<LeafSlot>::Get().Allocate())) LeafSlot;
+        } else {
+            node = ::new (static_cast<void *>(BumpAlo<InternalSlot>::Get().Allocate())) InternalSlot;
+        }
+        node->parent = nullptr;
+        node->position = 0;
+        node->count = 0;
+        node->leaf = leaf;
+        return node;
+    }
+
+    static void DeleteNode(LeafNode *node) {
+        if(node->leaf) {
+            BumpAlo<LeafSlot>::Get().Deallocate(static_cast<LeafSlot *>(node));
+        } else {
+            BumpAlo<InternalSlot>::Get().Deallocate(static_cast<InternalSlot *>(AsInternal(node)));
+        }
+    }
+
+    static void DeleteTree(LeafNode *node) {
+        for(size_t i = 0; i < node->count; ++i) {
+            node->slot(i)->~value_type();
+        }
+        if(!node->leaf) {
+            for(size_t i = 0; i <= node->count; ++i) {
+                DeleteTree(AsInternal(node)->children[i]);
+            }
+        }
+        DeleteNode(node);
+    }
+
+    // moves a value into an empty slot and leaves the source slot empty
+    static void MoveSlot(LeafNode *dst, size_t dst_i, LeafNode *src, size_t src_i) {
+        ::new (static_cast<void *>(dst->slot(dst_i))) value_type(std::move(*src->slot(src_i)));
+        src->slot(src_i)->~value_type();
+    }
+
+    static void SetChild(InternalNode *parent, size_t i, LeafNode *child) {
+        parent->children[i] = child;
+        child->parent = parent;
+        child->position = static_cast<uint16_t>(i);
+    }
+
+    LeafNode *LeftmostLeaf() const {
+        LeafNode *node = root_;
+        if(node == nullptr) {
+            return nullptr;
+        }
+        while(!node->leaf) {
+            node = AsInternal(node)->children[0];
+        }
+        return node;
+    }
+
+    // index of the first value in node whose key is not less than key
+    size_t LowerBoundIn(LeafNode *node, const Key &key) const {
+        size_t i = 0;
+        while(i < node->count && comp_(node->slot(i)->first, key)) {
+            ++i;
+        }
+        return i;
+    }
+
+    template <class It>
+    It FindImpl(const Key &key) const {
+        LeafNode *node = root_;
+        while(node != nullptr) {
+            size_t i = LowerBoundIn(node, key);
+            if(i < node->count && !comp_(key, node->slot(i)->first)) {
+                return It(node, i);
+            }
+            if(node->leaf) {
+                break;
+            }
+            node = AsInternal(node)->children[i];
+        }
+        return It(root_, root_ ? root_->count : 0);
+    }
+
+    // every candidate found further down is smaller than the ones above
+    template <class It>
+    It BoundImpl(const Key &key, bool upper) const {
+        It candidate(root_, root_ ? root_->count : 0);
+        LeafNode *node = root_;
+        while(node != nullptr) {
+            size_t i = 0;
+            if(upper) {
+                while(i < node->count && !comp_(key, node->slot(i)->first)) {
+                    ++i;
+                }
+            } else {
+                i = LowerBoundIn(node, key);
+            }
+            if(i < node->count) {
+                candidate = It(node, i);
+            }
+            if(node->leaf) {
+                break;
+            }
+            node = AsInternal(node)->children[i];
+        }
+        return candidate;
+    }
+
+    // inserts top down, splitting every full node on the way
+    template <class... Args>
+    std::pair<iterator, bool> InsertUnique(const Key &key, Args&&... args) {
+        if(root_ == nullptr) {
+            root_ = NewNode(true);
+        }
+        if(root_->count == kSlots) {
+            InternalNode *root = AsInternal(NewNode(false));
+            SetChild(root, 0, root_);
+            root_ = root;
+            SplitChild(root, 0);
+        }
+
+        LeafNode *node = root_;
+        while(true) {
+            size_t i = LowerBoundIn(node, key);
+            if(i < node->count && !comp_(key, node->slot(i)->first)) {
+                return {iterator(node, i), false};
+            }
+            if(node->leaf) {
+                for(size_t j = node->count; j > i; --j) {
+                    MoveSlot(node, j, node, j - 1);
+                }
+                ::new (static_cast<void *>(node->slot(i))) value_type(std::forward<Args>(args)...);
+                ++node->count;
+                ++size_;
+                return {iterator(node, i), true};
+            }
+            InternalNode *internal = AsInternal(node);
+            if(internal->children[i]->count == kSlots) {
+                SplitChild(internal, i);
+                // the median of the child moved to slot i
+                if(!comp_(key, node->slot(i)->first)) {
+                    if(!comp_(node->slot(i)->first, key)) {
+                        return {iterator(node, i), false};
+                    }
+                    ++i;
+                }
+            }
+            node = internal->children[i];
+        }
+    }
+
+    // appends a value greater than all others. A full rightmost leaf hands 
+    // its last value up and the new value starts the next leaf, so all 
+    // nodes left of the rightmost path stay filled.
+    iterator AppendRight(value_type &&value) {
+        if(root_ == nullptr) {
+            root_ = NewNode(true);
+        }
+        LeafNode *left = root_;
+        while(!left->leaf) {
+            left = AsInternal(left)->children[left->count];
+        }
+        ++size_;
+
+        if(left->count < kSlots) {
+            ::new (static_cast<void *>(left->slot(left->count))) value_type(std::move(value));
+            ++left->count;
+            return iterator(left, left->count - 1);
+        }
+
+        LeafNode *right = NewNode(true);
+        ::new (static_cast<void *>(right->slot(0))) value_type(std::move(value));
+        right->count = 1;
+        iterator result(right, 0);
+
+        // the last value of left separates left and right one level up
+        while(true) {
+            InternalNode *parent = left->parent;
+            if(parent == nullptr) {
+                parent = AsInternal(NewNode(false));
+                SetChild(parent, 0, left);
+                root_ = parent;
+            }
+            if(parent->count < kSlots) {
+                MoveSlot(parent, parent->count, left, left->count - 1);
+                --left->count;
+                SetChild(parent, parent->count + 1, right);
+                ++parent->count;
+                return result;
+            }
+            // the parent is full, left and right get a new parent which 
+            // becomes the right sibling of the full one
+            InternalNode *sibling = AsInternal(NewNode(false));
+            MoveSlot(sibling, 0, left, left->count - 1);
+            --left->count;
+            SetChild(sibling, 0, left);
+            SetChild(sibling, 1, right);
+            sibling->count = 1;
+            left = parent;
+            right = sibling;
+        }
+    }
+
+    // splits the full child i of parent, its median moves up to parent
+    void SplitChild(InternalNode *parent, size_t i) {
+        LeafNode *child = parent->children[i];
+        LeafNode *right = NewNode(child->leaf);
+        const size_t mid = kSlots / 2;
+
+        for(size_t j = mid + 1; j < child->count; ++j) {
+            MoveSlot(right, j - mid - 1, child, j);
+        }
+        if(!child->leaf) {
+            for(size_t j = mid + 1; j <= child->count; ++j) {
+                SetChild(AsInternal(right), j - mid - 1, AsInternal(child)->children[j]);
+            }
+        }
+        right->count = static_cast<uint16_t>(child->count - mid - 1);
+
+        for(size_t j = parent->count; j > i; --j) {
+            MoveSlot(parent, j, parent, j - 1);
+        }
+        for(size_t j = parent->count + 1; j > i + 1; --j) {
+            SetChild(parent, j, parent->children[j - 1]);
+        }
+        MoveSlot(parent, i, child, mid);
+        SetChild(parent, i + 1, right);
+
+        child->count = static_cast<uint16_t>(mid);
+        ++parent->count;
+    }
+
+    void EraseImpl(LeafNode *node, size_t i) {
+        node->slot(i)->~value_type();
+        if(!node->leaf) {
+            // the predecessor from the rightmost leaf of the left subtree takes its place
+            LeafNode *leaf = AsInternal(node)->children[i];
+            while(!leaf->leaf) {
+                leaf = AsInternal(leaf)->children[leaf->count];
+            }
+            MoveSlot(node, i, leaf, leaf->count - 1);
+            node = leaf;
+        } else {
+            for(size_t j = i + 1; j < node->count; ++j) {
+                MoveSlot(node, j - 1, node, j);
+            }
+        }
+        --node->count;
+        --size_;
+        Rebalance(node);
+    }
+
+    // refills underfull nodes bottom up, by borrowing from or merging with a sibling
+    void Rebalance(LeafNode *node) {
+        while(node != root_ && node->count < kMinSlots) {
+            InternalNode *parent = node->parent;
+            const size_t pos = node->position;
+            LeafNode *left = pos > 0 ? parent->children[pos - 1] : nullptr;
+            LeafNode *right = pos < parent->count ? parent->children[pos + 1] : nullptr;
+
+            if(left != nullptr && left->count > kMinSlots) {
+                RotateRight(parent, pos - 1);
+                return;
+            }
+            if(right != nullptr && right->count > kMinSlots) {
+                RotateLeft(parent, pos);
+                return;
+            }
+            Merge(parent, left != nullptr ? pos - 1 : pos);
+            node = parent;
+        }
+
+        if(root_->count == 0) {
+            LeafNode *old_root = root_;
+            if(old_root->leaf) {
+                root_ = nullptr;
+            } else {
+                root_ = AsInternal(old_root)->children[0];
+                root_->parent = nullptr;
+                root_->position = 0;
+            }
+            DeleteNode(old_root);
+        }
+    }
+
+    // moves the last value of child k through the parent to child k+1
+    void RotateRight(InternalNode *parent, size_t k) {
+        LeafNode *left = parent->children[k];
+        LeafNode *right = parent->children[k + 1];
+
+        for(size_t j = right->count; j > 0; --j) {
+            MoveSlot(right, j, right, j - 1);
+        }
+        MoveSlot(right, 0, parent, k);
+        MoveSlot(parent, k, left, left->count - 1);
+        if(!right->leaf) {
+            for(size_t j = right->count + 1; j > 0; --j) {
+                SetChild(AsInternal(right), j, AsInternal(right)->children[j - 1]);
+            }
+            SetChild(AsInternal(right), 0, AsInternal(left)->children[left->count]);
+        }
+        ++right->count;
+        --left->count;
+    }
+
+    // moves the first value of child k+1 through the parent to child k
+    void RotateLeft(InternalNode *parent, size_t k) {
+        LeafNode *left = parent->children[k];
+        LeafNode *right = parent->children[k + 1];
+
+        MoveSlot(left, left->count, parent, k);
+        MoveSlot(parent, k, right, 0);
+        if(!left->leaf) {
+            SetChild(AsInternal(left), left->count + 1, AsInternal(right)->children[0]);
+        }
+        for(size_t j = 1; j < right->count; ++j) {
+            MoveSlot(right, j - 1, right, j);
+        }
+        if(!right->leaf) {
+            for(size_t j = 1; j <= right->count; ++j) {
+                SetChild(AsInternal(right), j - 1, AsInternal(right)->children[j]);
+            }
+        }
+        ++left->count;
+        --right->count;
+    }
+
+    // merges child k+1 and the separating value into child k
+    void Merge(InternalNode *parent, size_t k) {
+        LeafNode *left = parent->children[k];
+        LeafNode *right = parent->children[k + 1];
+
+        MoveSlot(left, left->count, parent, k);
+        for(size_t j = 0; j < right->count; ++j) {
+            MoveSlot(left, left->count + 1 + j, right, j);
+        }
+        if(!left->leaf) {
+            for(size_t j = 0; j <= right->count; ++j) {
+                SetChild(AsInternal(left), left->count + 1 + j, AsInternal(right)->children[j]);
+            }
+        }
+        left->count = static_cast<uint16_t>(left->count + 1 + right->count);
+
+        for(size_t j = k + 1; j < parent->count; ++j) {
+            MoveSlot(parent, j - 1, parent, j);
+        }
+        for(size_t j = k + 2; j <= parent->count; ++j) {
+            SetChild(parent, j - 1, parent->children[j]);
+        }
+        --parent->count;
+        DeleteNode(right);
+    }
+};
+
+template <class Key, class T, class Compare, size_t NodeBytes>
+constexpr size_t PooledBTreeMap<Key, T, Compare, NodeBytes>::kSlots;
+
+template <class Key, class T, class Compare, size_t NodeBytes>
+constexpr size_t PooledBTreeMap<Key, T, Compare, NodeBytes>::kMinSlots;
+
+template <class Key, class T, class Compare, size_t NodeBytes>
+bool operator==(const PooledBTreeMap<Key, T, Compare, NodeBytes> &a, const PooledBTreeMap<Key, T, Compare, NodeBytes> &b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+template <class Key, class T, class Compare, size_t NodeBytes>
+bool operator!=(const PooledBTreeMap<Key, T, Compare, NodeBytes> &a, const PooledBTreeMap<Key, T, Compare, NodeBytes> &b) {
+    return !(a == b);
+}
+
+template <class Key, class T, class Compare, size_t NodeBytes>
+bool operator<(const PooledBTreeMap<Key, T, Compare, NodeBytes> &a, const PooledBTreeMap<Key, T, Compare, NodeBytes> &b) {
+    return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+}
+
+template <class Key, class T, class Compare, size_t NodeBytes>
+bool operator>(const PooledBTreeMap<Key, T, Compare, NodeBytes> &a, const PooledBTreeMap<Key, T, Compare, NodeBytes> &b) {
+    return b < a;
+}
+
+template <class Key, class T, class Compare, size_t NodeBytes>
+bool operator<=(const PooledBTreeMap<Key, T, Compare, NodeBytes> &a, const PooledBTreeMap<Key, T, Compare, NodeBytes> &b) {
+    return !(b < a);
+}
+
+template <class Key, class T, class Compare, size_t NodeBytes>
+bool operator>=(const PooledBTreeMap<Key, T, Compare, NodeBytes> &a, const PooledBTreeMap<Key, T, Compare, NodeBytes> &b) {
+    return !(a < b);
+}
+
+template <class Key, class T, class Compare, size_t NodeBytes>
+void swap(PooledBTreeMap<Key, T, Compare, NodeBytes> &a, PooledBTreeMap<Key, T, Compare, NodeBytes> &b) noexcept {
+    a.swap(b);
+}
+
+#endif // POOLEDBTREEMAP_H
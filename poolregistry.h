@@ -0,0 +1,168 @@
+#ifndef POOLREGISTRY_H
+#define POOLREGISTRY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include "typename.h"
+
+/// @brief PoolInfo
+/// @details Snapshot of a registered pool.
+struct PoolInfo {
+    TypeNameView name;
+    uint64_t type_id;
+    size_t size_of_type;
+    size_t size_of_pool;
+    size_t no_blocks;
+    size_t no_free_slots;
+};
+
+/// @brief PoolRegistry
+///
+/// @details
+///
+///        Lock free list of all live pools, every BumpAlo<T> registers
+///        itself under GetTypeKey<T>() on construction. The type id is
+///        only kept for display, types spelled alike share it.
+///
+///        entries : [key|id|name|pool|inspect][key|id|name|pool|inspect]...
+///
+///        Entries are claimed with an atomic increment and published by
+///        storing the pool pointer, an unregistered pool leaves an empty
+///        entry behind. The registry has a fixed capacity and neither
+///        registering nor listing pools allocates. Pools registered once
+///        the registry is full are dropped and counted, see
+///        GetNoOfDroppedPools.
+///
+/// @attention
+///
+///        Inspecting a pool reads its counters without synchronisation,
+///        the numbers are only exact if the owning thread is not using it.
+class PoolRegistry {
+
+    public:
+        using InspectFunction = PoolInfo (*)(const void *pool);
+
+        static constexpr size_t kMaxPools = 1024;
+
+        static PoolRegistry & Get() {
+            static PoolRegistry instance;
+            return instance;
+        }
+
+        /// @brief Registers a pool
+        /// @param type_key GetTypeKey of the pool's type
+        /// @param type_id
+        /// @param name
+        /// @param pool
+        /// @param inspect reads the PoolInfo of pool
+        /// @return false if the registry is full
+        bool Register(const void *type_key, uint64_t type_id, TypeNameView name, const void *pool, InspectFunction inspect) {
+            size_t i = no_entries_.fetch_add(1, std::memory_order_relaxed);
+            if(i >= kMaxPools) {
+                return false;
+            }
+            entries_[i].type_key = type_key;
+            entries_[i].type_id = type_id;
+            entries_[i].name = name;
+            entries_[i].inspect = inspect;
+            entries_[i].pool.store(pool, std::memory_order_release);
+            return true;
+        }
+
+        void Unregister(const void *pool) {
+            for(size_t i = 0; i < GetNoOfEntries(); ++i) {
+                const void *expected = pool;
+                if(entries_[i].pool.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel)) {
+                    return;
+                }
+            }
+        }
+
+        /// @brief Calls f(const PoolInfo &) for every live pool
+        template <class F>
+        void ForEach(F f) const {
+            for(size_t i = 0; i < GetNoOfEntries(); ++i) {
+                const void *pool = entries_[i].pool.load(std::memory_order_acquire);
+                if(pool != nullptr) {
+                    f(entries_[i].inspect(pool));
+                }
+            }
+        }
+
+        /// @brief Find
+        /// @param type_key GetTypeKey of the pool's type
+        /// @param info of the pool, if found
+        /// @return false if no pool is registered under type_key
+        bool Find(const void *type_key, PoolInfo &info) const {
+            for(size_t i = 0; i < GetNoOfEntries(); ++i) {
+                const void *pool = entries_[i].pool.load(std::memory_order_acquire);
+                if(pool != nullptr && entries_[i].type_key == type_key) {
+                    info = entries_[i].inspect(pool);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// @brief GetNoOfPools
+        /// @return number of live pools
+        size_t GetNoOfPools() const {
+            size_t no_pools = 0;
+            for(size_t i = 0; i < GetNoOfEntries(); ++i) {
+                if(entries_[i].pool.load(std::memory_order_acquire) != nullptr) {
+                    ++no_pools;
+                }
+            }
+            return no_pools;
+        }
+
+        /// @brief GetNoOfDroppedPools
+        /// @return number of pools which were not registered, because the registry was full
+        size_t GetNoOfDroppedPools() const {
+            size_t no_entries = no_entries_.load(std::memory_order_relaxed);
+            return no_entries > kMaxPools ? no_entries - kMaxPools : 0;
+        }
+
+        /// @brief Prints one line per live pool
+        void Print(std::ostream &os) const {
+            ForEach([&os](const PoolInfo &info) {
+                os << info.name << " id " << info.type_id << " type size " << info.size_of_type
+                   << " slots " << info.size_of_pool << " free " << info.no_free_slots
+                   << " blocks " << info.no_blocks << "\n";
+            });
+            const size_t no_dropped = GetNoOfDroppedPools();
+            if(no_dropped > 0) {
+                os << no_dropped << " pools dropped, registry is full\n";
+            }
+        }
+
+    private:
+        struct Entry {
+            std::atomic<const void *> pool{nullptr};
+            const void *type_key{nullptr};
+            uint64_t type_id{0};
+            TypeNameView name{};
+            InspectFunction inspect{nullptr};
+        };
+
+        PoolRegistry() = default;
+        ~PoolRegistry() = default;
+
+        PoolRegistry(const PoolRegistry&)= delete;
+        PoolRegistry& operator=(const PoolRegistry&)= delete;
+
+        size_t GetNoOfEntries() const {
+            size_t no_entries = no_entries_.load(std::memory_order_acquire);
+            if(no_entries > kMaxPools) {
+                no_entries = kMaxPools;
+            }
+            return no_entries;
+        }
+
+        std::atomic<size_t> no_entries_{0};
+        Entry entries_[kMaxPools];
+};
+
+#endif // POOLREGISTRY_H
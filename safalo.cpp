@@ -1,10 +1,443 @@
 
 #include <iostream>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "safalo.h"
 
 
+/// Sampling heap profiler
+///
+///        Every thread counts down the bytes until its next sample. Only
+///        when the count drops below zero, the allocation is recorded with
+///        its stack. The distances between samples are exponentially
+///        distributed (Poisson process over the allocated bytes), so the
+///        sampled bytes are an unbiased estimate of the allocated bytes.
+///
+///        Sampled allocations live in a fixed size table, nothing in here
+///        uses operator new. On delete the table is only searched if the
+///        filter bit of the pointer's hash is set. The filter is one bit
+///        per hash (8 KiB) so it stays in L1, the number of samples per
+///        hash is only kept for the slow path.
+///
+///        The stack is taken by walking the frame pointers, which is much
+///        cheaper than the unwinder of backtrace(). Callers compiled without
+///        frame pointers end the walk early or are skipped.
+///
+///        A dump copies the samples under the lock and writes the copy to
+///        a temporary file, which is renamed to the profile when complete.
+namespace {
+
+constexpr size_t kDefaultSampleInterval = 512 * 1024;
+constexpr int kMaxFrames = 32;
+constexpr size_t kSampleTableBits = 13;
+constexpr size_t kSampleTableSize = size_t{1} << kSampleTableBits;
+constexpr size_t kFilterBits = 16;
+constexpr size_t kFilterSize = size_t{1} << kFilterBits;
+constexpr size_t kMaxPathLength = 4096;
+// larger steps between two frame records end the stack walk
+constexpr uintptr_t kMaxFrameSize = 128 * 1024;
+
+struct Sample {
+    size_t size;
+    int depth;
+    void *frames[kMaxFrames];
+};
+
+// 0 while sampling is off
+std::atomic<size_t> g_sample_interval{0};
+std::atomic<size_t> g_no_samples{0};
+// on its own cache line, taking it does not disturb operator delete
+alignas(64) std::atomic_flag g_sample_lock = ATOMIC_FLAG_INIT;
+// the sampled pointers are kept apart from their stacks, so probing the
+// table touches few cache lines, nullptr: slot is empty
+void *g_sample_ptrs[kSampleTableSize];
+Sample g_samples[kSampleTableSize];
+// copy of the samples written by a dump, guarded by g_dump_lock
+alignas(64) std::atomic_flag g_dump_lock = ATOMIC_FLAG_INIT;
+Sample g_dump_samples[kSampleTableSize];
+// read by operator delete, only written with the lock held
+alignas(64) std::atomic<uint64_t> g_filter[kFilterSize / 64];
+uint16_t g_filter_counts[kFilterSize];
+char g_signal_path[kMaxPathLength];
+
+__attribute__((tls_model("initial-exec"))) thread_local int64_t t_bytes_until_sample = 0;
+__attribute__((tls_model("initial-exec"))) thread_local uint64_t t_rng_state = 0;
+
+
+size_t Hash(const void *ptr, size_t bits) {
+    return static_cast<size_t>((reinterpret_cast<uintptr_t>(ptr) >> 4) * 0x9E3779B97F4A7C15ull >> (64 - bits));
+}
+
+// exponentially distributed distance to the next sample
+int64_t NextSampleInterval(size_t mean) {
+    if(t_rng_state == 0) {
+        t_rng_state = reinterpret_cast<uintptr_t>(&t_rng_state) * 0x9E3779B97F4A7C15ull | 1;
+    }
+    // xorshift64*
+    t_rng_state ^= t_rng_state >> 12;
+    t_rng_state ^= t_rng_state << 25;
+    t_rng_state ^= t_rng_state >> 27;
+    const uint64_t r = t_rng_state * 0x2545F4914F6CDD1Dull;
+    // uniform in (0, 1]
+    const double u = (static_cast<double>(r >> 11) + 1.0) / 9007199254740992.0;
+    const double interval = -std::log(u) * static_cast<double>(mean);
+    return interval < 1.0 ? 1 : static_cast<int64_t>(interval);
+}
+
+bool IsInFilter(const void *ptr) {
+    const size_t h = Hash(ptr, kFilterBits);
+    return (g_filter[h / 64].load(std::memory_order_relaxed) >> (h % 64) & 1) != 0;
+}
+
+void AddToFilter(const void *ptr) {
+    const size_t h = Hash(ptr, kFilterBits);
+    if(g_filter_counts[h]++ == 0) {
+        g_filter[h / 64].fetch_or(uint64_t{1} << (h % 64), std::memory_order_relaxed);
+    }
+}
+
+void RemoveFromFilter(const void *ptr) {
+    const size_t h = Hash(ptr, kFilterBits);
+    if(--g_filter_counts[h] == 0) {
+        g_filter[h / 64].fetch_and(~(uint64_t{1} << (h % 64)), std::memory_order_relaxed);
+    }
+}
+
+void Lock(std::atomic_flag &lock = g_sample_lock) {
+    while(lock.test_and_set(std::memory_order_acquire)) {
+    }
+}
+
+bool TryLock(std::atomic_flag &lock = g_sample_lock) {
+    return !lock.test_and_set(std::memory_order_acquire);
+}
+
+void Unlock(std::atomic_flag &lock = g_sample_lock) {
+    lock.clear(std::memory_order_release);
+}
+
+// writes every page without changing it
+void TouchPages(void *begin, size_t bytes) {
+    volatile char *page = static_cast<volatile char *>(begin);
+    for(size_t i = 0; i < bytes; i += 4096) {
+        page[i] = page[i];
+    }
+}
+
+// return addresses of the callers of the frame fp, the walk stops at
+// the first link which does not point further up the stack
+int WalkFramePointers(void **fp, void **frames, int max_depth) {
+    int depth = 0;
+    while(depth < max_depth) {
+        // frame record: [caller's frame pointer][return address]
+        void **next = static_cast<void **>(fp[0]);
+        void *ret = fp[1];
+        if(ret == nullptr) {
+            break;
+        }
+        frames[depth++] = ret;
+        const uintptr_t from = reinterpret_cast<uintptr_t>(fp);
+        const uintptr_t to = reinterpret_cast<uintptr_t>(next);
+        if(to <= from || to - from > kMaxFrameSize || to % sizeof(void *) != 0) {
+            break;
+        }
+        fp = next;
+    }
+    return depth;
+}
+
+__attribute__((noinline)) void SampleAllocation(void *ptr, size_t size) {
+    const size_t interval = g_sample_interval.load(std::memory_order_relaxed);
+    if(interval == 0) {
+        // sampling is off, look again later
+        t_bytes_until_sample = kDefaultSampleInterval;
+        return;
+    }
+    t_bytes_until_sample = NextSampleInterval(interval);
+
+    // starts with the return address into operator new
+    void *frames[kMaxFrames];
+    const int depth = WalkFramePointers(static_cast<void **>(__builtin_frame_address(0)), frames, kMaxFrames);
+
+    Lock();
+    if(g_no_samples.load(std::memory_order_relaxed) < kSampleTableSize - 1) {
+        size_t i = Hash(ptr, kSampleTableBits);
+        while(g_sample_ptrs[i] != nullptr) {
+            i = (i + 1) & (kSampleTableSize - 1);
+        }
+        g_sample_ptrs[i] = ptr;
+        Sample &sample = g_samples[i];
+        sample.size = size;
+        sample.depth = depth;
+        std::memcpy(sample.frames, frames, depth * sizeof(void *));
+        AddToFilter(ptr);
+        g_no_samples.fetch_add(1, std::memory_order_relaxed);
+    }
+    Unlock();
+}
+
+void ForgetAllocation(void *ptr) {
+    // an empty slot holds nullptr too
+    if(ptr == nullptr) {
+        return;
+    }
+    Lock();
+    size_t i = Hash(ptr, kSampleTableBits);
+    while(g_sample_ptrs[i] != nullptr && g_sample_ptrs[i] != ptr) {
+        i = (i + 1) & (kSampleTableSize - 1);
+    }
+    if(g_sample_ptrs[i] == ptr) {
+        g_sample_ptrs[i] = nullptr;
+        RemoveFromFilter(ptr);
+        g_no_samples.fetch_sub(1, std::memory_order_relaxed);
+
+        // linear probing without tombstones, move later entries of the
+        // probe sequence into the hole
+        size_t hole = i;
+        size_t j = (i + 1) & (kSampleTableSize - 1);
+        while(g_sample_ptrs[j] != nullptr) {
+            size_t home = Hash(g_sample_ptrs[j], kSampleTableBits);
+            if(((j - home) & (kSampleTableSize - 1)) >= ((j - hole) & (kSampleTableSize - 1))) {
+                g_sample_ptrs[hole] = g_sample_ptrs[j];
+                g_samples[hole] = g_samples[j];
+                g_sample_ptrs[j] = nullptr;
+                hole = j;
+            }
+            j = (j + 1) & (kSampleTableSize - 1);
+        }
+    }
+    Unlock();
+}
+
+
+// async signal safe output, no stdio
+class ProfileWriter {
+    public:
+        explicit ProfileWriter(int fd) : fd_{fd}, len_{0}, ok_{true} {}
+
+        ~ProfileWriter() {
+            Flush();
+        }
+
+        void Write(const char *str) {
+            while(*str != '\0') {
+                Put(*str++);
+            }
+        }
+
+        void WriteDec(uint64_t value) {
+            char buf[20];
+            int n = 0;
+            do {
+                buf[n++] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while(value != 0);
+            while(n > 0) {
+                Put(buf[--n]);
+            }
+        }
+
+        void WriteHex(uint64_t value) {
+            char buf[16];
+            int n = 0;
+            do {
+                buf[n++] = "0123456789abcdef"[value & 0xf];
+                value >>= 4;
+            } while(value != 0);
+            Write("0x");
+            while(n > 0) {
+                Put(buf[--n]);
+            }
+        }
+
+        void WriteFile(const char *path) {
+            int fd = ::open(path, O_RDONLY);
+            if(fd < 0) {
+                ok_ = false;
+                return;
+            }
+            Flush();
+            ssize_t n;
+            while((n = ::read(fd, buf_, sizeof(buf_))) > 0) {
+                len_ = static_cast<size_t>(n);
+                Flush();
+            }
+            ::close(fd);
+        }
+
+        bool Flush() {
+            size_t done = 0;
+            while(done < len_) {
+                ssize_t n = ::write(fd_, buf_ + done, len_ - done);
+                if(n <= 0) {
+                    ok_ = false;
+                    break;
+                }
+                done += static_cast<size_t>(n);
+            }
+            len_ = 0;
+            return ok_;
+        }
+
+    private:
+        void Put(char c) {
+            if(len_ == sizeof(buf_)) {
+                Flush();
+            }
+            buf_[len_++] = c;
+        }
+
+        int fd_;
+        size_t len_;
+        bool ok_;
+        char buf_[4096];
+};
+
+// legacy pprof heap profile of the first no_samples dump samples, pprof
+// scales the samples by the interval
+bool WriteHeapProfile(const char *path, size_t no_samples, size_t interval) {
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        return false;
+    }
+
+    uint64_t no_bytes = 0;
+    for(size_t i = 0; i < no_samples; ++i) {
+        no_bytes += g_dump_samples[i].size;
+    }
+
+    bool ok;
+    {
+        ProfileWriter out(fd);
+        out.Write("heap profile: ");
+        out.WriteDec(no_samples);
+        out.Write(": ");
+        out.WriteDec(no_bytes);
+        out.Write(" [ ");
+        out.WriteDec(no_samples);
+        out.Write(": ");
+        out.WriteDec(no_bytes);
+        out.Write("] @ heap_v2/");
+        out.WriteDec(interval != 0 ? interval : kDefaultSampleInterval);
+        out.Write("\n");
+
+        for(size_t i = 0; i < no_samples; ++i) {
+            const Sample &sample = g_dump_samples[i];
+            out.Write("1: ");
+            out.WriteDec(sample.size);
+            out.Write(" [1: ");
+            out.WriteDec(sample.size);
+            out.Write("] @");
+            for(int f = 0; f < sample.depth; ++f) {
+                out.Write(" ");
+                out.WriteHex(reinterpret_cast<uintptr_t>(sample.frames[f]));
+            }
+            out.Write("\n");
+        }
+
+        out.Write("\nMAPPED_LIBRARIES:\n");
+        out.WriteFile("/proc/self/maps");
+        ok = out.Flush();
+    }
+    return ::close(fd) == 0 && ok;
+}
+
+bool DumpHeapProfileImpl(const char *path, bool in_signal_handler) {
+    // a failed dump leaves the previous profile alone
+    char tmp_path[kMaxPathLength + 4];
+    const size_t path_length = std::strlen(path);
+    if(path_length >= kMaxPathLength) {
+        return false;
+    }
+    std::memcpy(tmp_path, path, path_length);
+    std::memcpy(tmp_path + path_length, ".tmp", 5);
+
+    if(in_signal_handler) {
+        // the interrupted thread may hold either lock
+        if(!TryLock(g_dump_lock)) {
+            return false;
+        }
+        if(!TryLock()) {
+            Unlock(g_dump_lock);
+            return false;
+        }
+    } else {
+        Lock(g_dump_lock);
+        Lock();
+    }
+
+    // the samples are copied, the lock is not held during file I/O
+    size_t no_samples = 0;
+    for(size_t i = 0; i < kSampleTableSize; ++i) {
+        if(g_sample_ptrs[i] != nullptr) {
+            g_dump_samples[no_samples++] = g_samples[i];
+        }
+    }
+    const size_t interval = g_sample_interval.load(std::memory_order_relaxed);
+    Unlock();
+
+    bool ok = WriteHeapProfile(tmp_path, no_samples, interval) && ::rename(tmp_path, path) == 0;
+    if(!ok) {
+        ::unlink(tmp_path);
+    }
+    Unlock(g_dump_lock);
+    return ok;
+}
+
+void DumpHeapProfileHandler(int) {
+    int saved_errno = errno;
+    DumpHeapProfileImpl(g_signal_path, true);
+    errno = saved_errno;
+}
+
+} // namespace
+
+
+void SafAlo::StartSampling(size_t mean_interval_bytes) {
+    // fault the pages of the table in now, not in operator new
+    static std::atomic<bool> touched{false};
+    if(!touched.exchange(true)) {
+        Lock();
+        TouchPages(g_sample_ptrs, sizeof(g_sample_ptrs));
+        TouchPages(g_samples, sizeof(g_samples));
+        TouchPages(g_filter_counts, sizeof(g_filter_counts));
+        Unlock();
+    }
+    g_sample_interval.store(mean_interval_bytes > 0 ? mean_interval_bytes : 1, std::memory_order_relaxed);
+}
+
+void SafAlo::StopSampling() {
+    g_sample_interval.store(0, std::memory_order_relaxed);
+}
+
+size_t SafAlo::GetNoOfSampledAllocations() {
+    return g_no_samples.load(std::memory_order_relaxed);
+}
+
+bool SafAlo::DumpHeapProfile(const char *path) {
+    return DumpHeapProfileImpl(path, false);
+}
+
+void SafAlo::DumpHeapProfileOnSignal(int signo, const char *path) {
+    std::strncpy(g_signal_path, path, kMaxPathLength - 1);
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = DumpHeapProfileHandler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(signo, &action, nullptr);
+}
+
+
 void * operator new(std::size_t size) {
     if(!SafAlo::Get().IsAloAllowed()) {
         std::cerr << "Allocation Prohibited\n";
@@ -20,9 +453,14 @@ void * operator new(std::size_t size) {
         std::abort();
     }
 
+    // fast path of the heap profiler
+    if((t_bytes_until_sample -= static_cast<int64_t>(size)) < 0) {
+        SampleAllocation(p, size);
+    }
+
     #ifdef DEBUG_SAFALO
         std::cout << __FUNCTION__ << " ret : " << p << std::endl;
-    #endif 
+    #endif
     return p;
 }
 
@@ -46,10 +484,16 @@ void* operator new[](size_t size, const std::nothrow_t&) noexcept {
 
 
 void operator delete(void* ptr) noexcept {
+    if(ptr == nullptr) {
+        return;
+    }
+    if(g_no_samples.load(std::memory_order_relaxed) != 0 && IsInFilter(ptr)) {
+        ForgetAllocation(ptr);
+    }
     ::free(ptr);
     #ifdef DEBUG_SAF_ALO
         std::cout << __FUNCTION__ << " free @" << ptr << std::endl;
-    #endif 
+    #endif
 }
 
 void operator delete(void* ptr, const std::nothrow_t&) noexcept {
@@ -72,4 +516,4 @@ void operator delete[] (void* ptr, const std::nothrow_t&) noexcept {
 void operator delete[] (void* ptr, size_t) noexcept
 {
     ::operator delete[](ptr);
-}
\ No newline at end of file
+}
@@ -1,6 +1,9 @@
 #ifndef SAFALO_H
 #define SAFALO_H
 
+#include <atomic>
+#include <cstddef>
+
 class SafAlo {
 
     public: 
@@ -10,22 +13,51 @@ class SafAlo {
         }
 
         void AloPermit() {
-            alo_alow_ = true;
+            alo_alow_.store(true, std::memory_order_relaxed);
         }
 
         void AloProhibit() {
-            alo_alow_ = false;
+            alo_alow_.store(false, std::memory_order_relaxed);
         }
 
         bool IsAloAllowed() {
-            return alo_alow_;
+            return alo_alow_.load(std::memory_order_relaxed);
         }
 
+        /// @brief Starts the sampling heap profiler
+        /// @details On average one allocation per mean_interval_bytes 
+        ///          allocated bytes is sampled, together with its stack. 
+        ///          Sampled allocations are tracked until they are deleted.
+        /// @param mean_interval_bytes 
+        void StartSampling(size_t mean_interval_bytes = 512 * 1024);
+
+        /// @brief Stops sampling new allocations
+        /// @details Allocations sampled so far are still tracked.
+        void StopSampling();
+
+        /// @brief GetNoOfSampledAllocations
+        /// @return number of sampled allocations which are not deleted yet
+        size_t GetNoOfSampledAllocations();
+
+        /// @brief Writes the live sampled allocations as pprof heap profile
+        /// @details Does not allocate and is async signal safe. The profile
+        ///          is written to path.tmp first and renamed to path.
+        /// @param path 
+        /// @return false if the file could not be written, path is left
+        ///         unchanged then
+        bool DumpHeapProfile(const char *path);
+
+        /// @brief Dumps the heap profile to path whenever signo is raised
+        /// @param signo e.g. SIGUSR1
+        /// @param path 
+        void DumpHeapProfileOnSignal(int signo, const char *path);
+
     private:
         SafAlo() : alo_alow_{true} {}
         ~SafAlo() {};
 
-        bool alo_alow_;
+        // read by every thread's operator new
+        std::atomic<bool> alo_alow_;
 };
 
 #endif // SAFALO_H
\ No newline at end of file
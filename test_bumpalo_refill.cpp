@@ -0,0 +1,109 @@
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <set>
+#include "blockrefill.h"
+#include "safalo.h"
+
+int main() {
+
+        struct TestType1{
+            TestType1(uint64_t x) : x_{x} {}
+            uint64_t x_;
+        };
+
+        using ba1 = BumpAlo<TestType1>;
+
+        const size_t low_watermark = 4;
+        const size_t high_watermark = 16;
+
+        ba1::Get().AddMemory(high_watermark);
+        BlockRefill<TestType1>::Get().Start(low_watermark, high_watermark);
+
+        std::set<TestType1*> slots;
+        for(uint64_t i = 0; i < 1000; ++i) {
+            auto p = ba1::Get().Allocate();
+            ::new ((void*)p) TestType1(i);
+            slots.insert(p);
+            // give the refill thread time to catch up
+            if(ba1::Get().GetNoOfFreeSlots() < low_watermark) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+
+        assert(slots.size() == 1000);
+        assert(ba1::Get().GetSizeOfPool() >= 1000);
+        assert(ba1::Get().GetSizeOfPool() - ba1::Get().GetNoOfFreeSlots() == 1000);
+        // blocks are refilled up to the high watermark, not slot by slot
+        assert(ba1::Get().GetNoOfBlocks() < 1000 / (high_watermark - low_watermark) + 2);
+        // the bursts were served by blocks prepared in the background, a
+        // block added by Allocate itself only happens if the refill thread
+        // fell behind
+        const size_t no_refilled_blocks = BlockRefill<TestType1>::Get().GetNoOfRefilledBlocks();
+        const size_t no_added_blocks = ba1::Get().GetNoOfBlocks() - 1;
+        assert(no_refilled_blocks > 0);
+        assert(no_refilled_blocks <= no_added_blocks);
+        assert(no_refilled_blocks * 10 >= no_added_blocks * 9);
+
+        for(auto p : slots) {
+            ba1::Get().Deallocate(p);
+        }
+        assert(ba1::Get().GetNoOfFreeSlots() == ba1::Get().GetSizeOfPool());
+
+        BlockRefill<TestType1>::Get().Stop();
+        const size_t no_refilled_blocks_stopped = BlockRefill<TestType1>::Get().GetNoOfRefilledBlocks();
+
+        // without refill the pool grows slot by slot again
+        const size_t no_blocks = ba1::Get().GetNoOfBlocks();
+        const size_t no_free_slots = ba1::Get().GetNoOfFreeSlots();
+        for(size_t j = 0; j < no_free_slots + 1; ++j) {
+            ba1::Get().Allocate();
+        }
+        assert(ba1::Get().GetNoOfBlocks() == no_blocks + 1);
+        assert(BlockRefill<TestType1>::Get().GetNoOfRefilledBlocks() == no_refilled_blocks_stopped);
+
+        // the refill thread keeps working while SafAlo prohibits allocations
+        struct TestType2{
+            uint64_t x_;
+            uint64_t y_;
+        };
+
+        using ba2 = BumpAlo<TestType2>;
+
+        ba2::Get().AddMemory(64);
+        BlockRefill<TestType2>::Get().Start(16, 64);
+        SafAlo::Get().AloProhibit();
+        for(uint64_t i = 0; i < 1000; ++i) {
+            ba2::Get().Allocate()->x_ = i;
+            if(ba2::Get().GetNoOfFreeSlots() < 16) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+        SafAlo::Get().AloPermit();
+        assert(ba2::Get().GetSizeOfPool() - ba2::Get().GetNoOfFreeSlots() == 1000);
+        assert(BlockRefill<TestType2>::Get().GetNoOfRefilledBlocks() > 0);
+        BlockRefill<TestType2>::Get().Stop();
+
+        // adopting a block in guard mode does not allocate either
+        struct TestType3{
+            uint64_t x_;
+            uint64_t y_;
+        };
+
+        using ba3 = BumpAlo<TestType3>;
+
+        ba3::Get().EnableGuard();
+        ba3::Get().AddMemory(64);
+        BlockRefill<TestType3>::Get().Start(16, 64);
+        SafAlo::Get().AloProhibit();
+        for(uint64_t i = 0; i < 1000; ++i) {
+            ba3::Get().Allocate()->x_ = i;
+            if(ba3::Get().GetNoOfFreeSlots() < 16) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+        SafAlo::Get().AloPermit();
+        assert(ba3::Get().GetSizeOfPool() - ba3::Get().GetNoOfFreeSlots() == 1000);
+        assert(BlockRefill<TestType3>::Get().GetNoOfRefilledBlocks() > 0);
+        BlockRefill<TestType3>::Get().Stop();
+}
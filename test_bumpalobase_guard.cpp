@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "typename.h"
+#include "bumpalobase.h"
+
+struct TestType1{
+    TestType1(uint64_t x, uint64_t y) : x_{x}, y_{y} {}
+    uint64_t x_;
+    uint64_t y_;
+};
+
+
+TEST(BumpAloBaseGuard, success) {
+    BumpAloBase<TestType1> ba;
+    ba.EnableGuard();
+    EXPECT_TRUE(ba.IsGuarded());
+
+    uint64_t no_slots = 6;
+    ba.AddMemory(no_slots);
+    ba.AddMemory(no_slots);
+
+    TestType1 *slots[12];
+    for(uint64_t i = 0; i < no_slots*2; ++i) {
+        slots[i] = ba.Allocate();
+        new (static_cast<void*>(slots[i])) TestType1(i, i*i);
+    }
+    EXPECT_TRUE(ba.IsEndOfBlock());
+    for(uint64_t i = 0; i < no_slots*2; ++i) {
+        EXPECT_EQ(slots[i]->x_, i);
+        EXPECT_EQ(slots[i]->y_, i*i);
+    }
+
+    // hand back in a different order than handed out
+    for(uint64_t i = 0; i < no_slots*2; i += 2) {
+        ba.Deallocate(slots[i]);
+    }
+    for(uint64_t i = 1; i < no_slots*2; i += 2) {
+        ba.Deallocate(slots[i]);
+    }
+    EXPECT_EQ(ba.GetNoOfFreeSlots(), no_slots*2);
+
+    auto p = ba.Allocate();
+    EXPECT_EQ(p, slots[no_slots*2 - 1]);
+    ba.Deallocate(p);
+
+    EXPECT_EQ(ba.ReleaseFreeBlocks(), 2u);
+    EXPECT_EQ(ba.GetNoOfBlocks(), 0u);
+
+    ba.AddMemory(1);
+    p = ba.Allocate();
+    new (static_cast<void*>(p)) TestType1(1, 2);
+    ba.Deallocate(p);
+}
+
+TEST(BumpAloBaseGuard, large_blocks) {
+    BumpAloBase<TestType1> ba;
+    ba.EnableGuard();
+
+    // more slots than fit into one guarded block give a chain of blocks
+    const uint64_t no_slots = 100000;
+    ba.AddMemory(no_slots);
+    ba.AddMemory(3);
+    EXPECT_GT(ba.GetNoOfBlocks(), 2u);
+    EXPECT_EQ(ba.GetSizeOfPool(), no_slots + 3);
+
+    std::vector<TestType1 *> slots;
+    for(uint64_t i = 0; i < no_slots + 3; ++i) {
+        slots.push_back(ba.Allocate());
+        new (static_cast<void*>(slots.back())) TestType1(i, i);
+    }
+    EXPECT_TRUE(ba.IsEndOfBlock());
+    for(auto p : slots) {
+        ba.Deallocate(p);
+    }
+    EXPECT_DEATH(ba.Deallocate(slots[no_slots / 2]), "double free");
+    const size_t no_blocks = ba.GetNoOfBlocks();
+    EXPECT_EQ(ba.ReleaseFreeBlocks(), no_blocks);
+    EXPECT_EQ(ba.GetNoOfBlocks(), 0u);
+}
+
+TEST(BumpAloBaseGuard, double_free) {
+    BumpAloBase<TestType1> ba;
+    ba.EnableGuard();
+    ba.AddMemory(4);
+
+    auto p = ba.Allocate();
+    ba.Allocate();
+    ba.Deallocate(p);
+    EXPECT_DEATH(ba.Deallocate(p), "double free");
+}
+
+TEST(BumpAloBaseGuard, foreign_pointer) {
+    BumpAloBase<TestType1> ba;
+    ba.EnableGuard();
+    ba.AddMemory(4);
+
+    TestType1 t(1, 2);
+    EXPECT_DEATH(ba.Deallocate(&t), "does not belong to the pool");
+}
+
+TEST(BumpAloBaseGuard, use_after_free) {
+    BumpAloBase<TestType1> ba;
+    ba.EnableGuard();
+    ba.AddMemory(4);
+
+    auto p = ba.Allocate();
+    new (static_cast<void*>(p)) TestType1(1, 1);
+    ba.Deallocate(p);
+    // write through a dangling pointer, AddressSanitizer catches the write
+    EXPECT_DEATH({
+        p->y_ = 42;
+        ba.Allocate();
+    }, "use after free|use-after-poison");
+}
+
+TEST(BumpAloBaseGuard, corrupted_free_list) {
+    BumpAloBase<TestType1> ba;
+    ba.EnableGuard();
+    ba.AddMemory(4);
+
+    auto p = ba.Allocate();
+    ba.Deallocate(p);
+    // overwrite the next pointer of the free slot
+    EXPECT_DEATH({
+        p->x_ = reinterpret_cast<uintptr_t>(&ba);
+        ba.Allocate();
+        ba.Allocate();
+    }, "free list corrupted|use-after-poison");
+}
+
+TEST(BumpAloBaseGuard, enable_after_creation) {
+    BumpAloBase<TestType1> ba;
+    ba.AddMemory(4);
+    EXPECT_DEATH(ba.EnableGuard(), "already been created");
+}
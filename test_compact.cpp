@@ -0,0 +1,111 @@
+#include <cassert>
+#include <map>
+#include <random>
+#include "compact.h"
+
+using Key = uint64_t;
+using T = uint64_t;
+using Type = std::pair<const Key, T>;
+using GCCInternalTypeForAMapNode = std::_Rb_tree_node<Type>;
+using Map = std::map<Key, T, std::less<Key>, PAlo<Type>>;
+using BTreeMap = PooledBTreeMap<Key, T>;
+
+// inserts and erases random keys, so nodes end up all over the pool
+template <class M>
+std::map<Key, T> Churn(M &m, size_t no_keys, size_t no_rounds) {
+    std::mt19937_64 rng(7);
+    std::map<Key, T> ref;
+    for(size_t round = 0; round < no_rounds; ++round) {
+        while(ref.size() < no_keys) {
+            Key key = rng() % (4 * no_keys);
+            m[key] = key + round;
+            ref[key] = key + round;
+        }
+        for(size_t i = 0; i < no_keys / 2; ++i) {
+            Key key = rng() % (4 * no_keys);
+            m.erase(key);
+            ref.erase(key);
+        }
+    }
+    return ref;
+}
+
+template <class M>
+void CheckSame(const M &m, const std::map<Key, T> &ref) {
+    assert(m.size() == ref.size());
+    auto it = m.begin();
+    for(const auto &n : ref) {
+        assert(it->first == n.first && it->second == n.second);
+        ++it;
+    }
+}
+
+// after compaction the nodes follow each other in key order
+void CheckContiguous(const Map &m) {
+    const char *prev = nullptr;
+    for(const auto &n : m) {
+        const char *node = reinterpret_cast<const char *>(&n);
+        if(prev != nullptr) {
+            assert(node - prev == static_cast<std::ptrdiff_t>(sizeof(GCCInternalTypeForAMapNode)));
+        }
+        prev = node;
+    }
+}
+
+int main() {
+
+    const size_t no_keys = 1000;
+    auto &pool = BumpAlo<GCCInternalTypeForAMapNode>::Get();
+
+    {
+        Map m;
+        auto ref = Churn(m, no_keys, 5);
+        const size_t no_blocks = pool.GetNoOfBlocks();
+
+        Compact(m);
+
+        CheckSame(m, ref);
+        CheckContiguous(m);
+        // the churn added one block per node, most of them are empty now
+        assert(pool.GetNoOfBlocks() < no_blocks);
+        assert(pool.GetSizeOfPool() - pool.GetNoOfFreeSlots() == m.size());
+    }
+
+    {
+        Map m;
+        auto ref = Churn(m, no_keys, 5);
+
+        MapCompactor<Map> compactor(m);
+        size_t no_steps = 0;
+        while(!compactor.Step(64)) {
+            // the map stays readable between steps
+            CheckSame(m, ref);
+            ++no_steps;
+        }
+        assert(no_steps >= 2 * ref.size() / 64 - 1);
+        CheckSame(m, ref);
+        CheckContiguous(m);
+
+        m[4 * no_keys] = 1;
+        assert(m.size() == ref.size() + 1);
+    }
+
+    {
+        BTreeMap m;
+        auto ref = Churn(m, no_keys, 5);
+        Compact(m);
+        CheckSame(m, ref);
+
+        MapCompactor<BTreeMap> compactor(m);
+        while(!compactor.Step(100)) {
+            CheckSame(m, ref);
+        }
+        CheckSame(m, ref);
+
+        // the map is still usable after compaction
+        for(const auto &n : ref) {
+            assert(m.erase(n.first) == 1);
+        }
+        assert(m.empty());
+    }
+}
@@ -0,0 +1,204 @@
+#include <cassert>
+#include <map>
+#include <random>
+#include <string>
+#include "pooledbtreemap.h"
+
+template <class Map>
+void CheckSame(const Map &m, const std::map<uint64_t, uint64_t> &ref) {
+    assert(m.size() == ref.size());
+    auto it = m.begin();
+    for(const auto &n : ref) {
+        assert(it != m.end());
+        assert(it->first == n.first);
+        assert(it->second == n.second);
+        ++it;
+    }
+    assert(it == m.end());
+
+    auto rit = m.rbegin();
+    for(auto n = ref.rbegin(); n != ref.rend(); ++n) {
+        assert(rit->first == n->first);
+        ++rit;
+    }
+    assert(rit == m.rend());
+}
+
+template <class Map>
+void RandomOperations(size_t no_operations, uint64_t max_key) {
+    std::mt19937_64 rng(42);
+    std::map<uint64_t, uint64_t> ref;
+    Map m;
+
+    for(size_t i = 0; i < no_operations; ++i) {
+        uint64_t key = rng() % max_key;
+        switch(rng() % 6) {
+            case 0: {
+                auto r = m.insert({key, key * key});
+                auto e = ref.insert({key, key * key});
+                assert(r.second == e.second);
+                assert(r.first->first == key);
+                break;
+            }
+            case 1: {
+                m[key] = i;
+                ref[key] = i;
+                break;
+            }
+            case 2: {
+                assert(m.erase(key) == ref.erase(key));
+                break;
+            }
+            case 3: {
+                auto it = m.find(key);
+                auto e = ref.find(key);
+                if(e == ref.end()) {
+                    assert(it == m.end());
+                    break;
+                }
+                assert(it != m.end() && it->second == e->second);
+                auto next = m.erase(it);
+                auto e_next = ref.erase(e);
+                assert((next == m.end()) == (e_next == ref.end()));
+                if(e_next != ref.end()) {
+                    assert(next->first == e_next->first);
+                }
+                break;
+            }
+            case 4: {
+                auto r = m.insert_or_assign(key, i);
+                bool inserted = ref.count(key) == 0;
+                ref[key] = i;
+                assert(r.second == inserted);
+                assert(r.first->first == key && r.first->second == i);
+                break;
+            }
+            case 5: {
+                uint64_t last_key = key + rng() % 16;
+                auto next = m.erase(m.lower_bound(key), m.lower_bound(last_key));
+                auto e_next = ref.erase(ref.lower_bound(key), ref.lower_bound(last_key));
+                assert((next == m.end()) == (e_next == ref.end()));
+                if(e_next != ref.end()) {
+                    assert(next->first == e_next->first);
+                }
+                break;
+            }
+        }
+
+        auto lb = m.lower_bound(key);
+        auto e_lb = ref.lower_bound(key);
+        assert((lb == m.end()) == (e_lb == ref.end()));
+        if(e_lb != ref.end()) {
+            assert(lb->first == e_lb->first);
+        }
+        auto ub = m.upper_bound(key);
+        auto e_ub = ref.upper_bound(key);
+        assert((ub == m.end()) == (e_ub == ref.end()));
+        if(e_ub != ref.end()) {
+            assert(ub->first == e_ub->first);
+        }
+
+        if(i % 1000 == 0) {
+            CheckSame(m, ref);
+        }
+    }
+    CheckSame(m, ref);
+
+    Map copy(m);
+    assert(copy == m);
+    assert(!(copy < m) && copy <= m && copy >= m);
+    CheckSame(copy, ref);
+    if(!copy.empty()) {
+        copy.erase(std::prev(copy.end()));
+        assert(copy < m && copy != m && m > copy);
+        copy = m;
+    }
+
+    // erase everything in order through the returned iterators
+    auto it = m.begin();
+    while(it != m.end()) {
+        it = m.erase(it);
+    }
+    assert(m.empty());
+    assert(m.begin() == m.end());
+    CheckSame(copy, ref);
+
+    // the whole range at once
+    auto next = copy.erase(copy.begin(), copy.end());
+    assert(next == copy.end());
+    assert(copy.empty());
+}
+
+// ascending values appended through emplace_hint(cend()) go through
+// AppendRight, other values are inserted the usual way
+template <class Map>
+void AppendOperations(size_t no_values) {
+    std::map<uint64_t, uint64_t> ref;
+    Map m;
+
+    for(uint64_t key = 0; key < no_values; ++key) {
+        auto it = m.emplace_hint(m.cend(), 2 * key, key);
+        ref.emplace_hint(ref.cend(), 2 * key, key);
+        assert(it->first == 2 * key && it->second == key);
+        assert(std::next(it) == m.end());
+        if(key % 100 == 0) {
+            CheckSame(m, ref);
+        }
+    }
+    CheckSame(m, ref);
+
+    // hint end() with keys which are not the greatest
+    for(uint64_t key = 1; key < 2 * no_values; key += 2) {
+        auto it = m.emplace_hint(m.cend(), key, key);
+        ref.emplace(key, key);
+        assert(it->first == key);
+        assert(m.emplace_hint(m.cend(), key, 0)->second == key);
+    }
+    CheckSame(m, ref);
+
+    // values erased from the filled nodes are refilled by rebalancing
+    for(uint64_t key = 0; key < 2 * no_values; key += 3) {
+        assert(m.erase(key) == ref.erase(key));
+    }
+    CheckSame(m, ref);
+}
+
+int main() {
+
+    // padded slots start on a cache line, also in blocks added later
+    struct Node {
+        uint64_t values[25];
+    };
+    using PaddedNode = CacheLinePadded<Node>;
+    static_assert(sizeof(PaddedNode) == 256, "node is not padded to 4 cache lines");
+    BumpAlo<PaddedNode>::Get().AddMemory(3);
+    for(size_t i = 0; i < 50; ++i) {
+        auto p = BumpAlo<PaddedNode>::Get().Allocate();
+        assert(reinterpret_cast<uintptr_t>(p) % 64 == 0);
+        BumpAlo<PaddedNode>::Get().AddMemory(i % 5 + 1);
+    }
+
+    // smallest nodes, 3 values per node, give deep trees
+    using SmallNodeMap = PooledBTreeMap<uint64_t, uint64_t, std::less<uint64_t>, 64>;
+    assert(SmallNodeMap::GetSlotsPerNode() == 3);
+    RandomOperations<SmallNodeMap>(20000, 500);
+    AppendOperations<SmallNodeMap>(2000);
+
+    using Map = PooledBTreeMap<uint64_t, uint64_t>;
+    Map::ReservePool(10000);
+    RandomOperations<Map>(50000, 5000);
+    AppendOperations<Map>(20000);
+
+    PooledBTreeMap<std::string, std::string> strings;
+    strings["b"] = "2";
+    strings.emplace("a", "1");
+    strings.try_emplace("c", "3");
+    assert(strings.size() == 3);
+    assert(strings.begin()->second == "1");
+    assert(strings.at("c") == "3");
+    assert(strings.count("d") == 0);
+    std::string key = "d";
+    assert(strings.insert_or_assign(std::move(key), "4").second);
+    assert(!strings.insert_or_assign("d", "5").second);
+    assert(strings.at("d") == "5");
+}
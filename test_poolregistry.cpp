@@ -0,0 +1,90 @@
+#include <cassert>
+#include <sstream>
+#include "safalo.h"
+#include "bumpalo.h"
+
+template <class Tag>
+struct Tagged {
+    uint64_t x_;
+    uint64_t y_;
+};
+
+int main() {
+
+        struct TestType1{
+            uint64_t x_;
+        };
+
+        struct TestType2{
+            uint64_t x_;
+            uint64_t y_;
+        };
+
+        // creating pools neither allocates nor demangles
+        SafAlo::Get().AloProhibit();
+        BumpAlo<TestType1>::Get();
+        BumpAlo<TestType2>::Get();
+        BumpAloBase<TestType1> ba;
+        assert(PoolRegistry::Get().GetNoOfPools() == 2);
+        SafAlo::Get().AloPermit();
+
+        BumpAlo<TestType1>::Get().AddMemory(4);
+        BumpAlo<TestType1>::Get().Allocate();
+        BumpAlo<TestType2>::Get().AddMemory(8);
+
+        PoolInfo info;
+        assert(PoolRegistry::Get().Find(GetTypeKey<TestType1>(), info));
+        assert(info.name == GetTypeNameView<TestType1>());
+        assert(info.size_of_type == sizeof(TestType1));
+        assert(info.size_of_pool == 4);
+        assert(info.no_free_slots == 3);
+        assert(info.no_blocks == 1);
+
+        assert(PoolRegistry::Get().Find(GetTypeKey<TestType2>(), info));
+        assert(info.size_of_type == sizeof(TestType2));
+        assert(info.size_of_pool == 8);
+
+        assert(!PoolRegistry::Get().Find(GetTypeKey<int>(), info));
+
+        // two lambdas of one function are spelled alike and share the
+        // type id, their pools are still found apart
+        auto tag_a = []{};
+        auto tag_b = []{};
+        using Tagged1 = Tagged<decltype(tag_a)>;
+        using Tagged2 = Tagged<decltype(tag_b)>;
+        assert(GetTypeId<Tagged1>() == GetTypeId<Tagged2>());
+        BumpAlo<Tagged1>::Get().AddMemory(1);
+        BumpAlo<Tagged2>::Get().AddMemory(2);
+        assert(PoolRegistry::Get().Find(GetTypeKey<Tagged1>(), info));
+        assert(info.size_of_pool == 1);
+        assert(PoolRegistry::Get().Find(GetTypeKey<Tagged2>(), info));
+        assert(info.size_of_pool == 2);
+
+        size_t no_pools = 0;
+        PoolRegistry::Get().ForEach([&no_pools](const PoolInfo &) { ++no_pools; });
+        assert(no_pools == 4);
+
+        std::ostringstream os;
+        PoolRegistry::Get().Print(os);
+        assert(os.str().find(std::string(GetTypeNameView<TestType2>())) != std::string::npos);
+        assert(PoolRegistry::Get().GetNoOfDroppedPools() == 0);
+
+        // registrations beyond the capacity are counted, not lost silently
+        static char fake_pools[PoolRegistry::kMaxPools + 2];
+        auto inspect = [](const void *) { return PoolInfo{}; };
+        size_t no_registered = 0;
+        for(auto &pool : fake_pools) {
+            if(PoolRegistry::Get().Register(GetTypeKey<char>(), GetTypeId<char>(), GetTypeNameView<char>(), &pool, inspect)) {
+                ++no_registered;
+            }
+        }
+        assert(no_registered == PoolRegistry::kMaxPools - 4);
+        assert(PoolRegistry::Get().GetNoOfDroppedPools() == 6);
+        std::ostringstream full;
+        PoolRegistry::Get().Print(full);
+        assert(full.str().find("6 pools dropped") != std::string::npos);
+        for(auto &pool : fake_pools) {
+            PoolRegistry::Get().Unregister(&pool);
+        }
+        assert(PoolRegistry::Get().GetNoOfPools() == 4);
+}
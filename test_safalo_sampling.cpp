@@ -0,0 +1,134 @@
+
+
+#include "safalo.h"
+#include <cassert>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// same hash as the profiler's delete filter, nullptr falls into bucket 0
+static bool IsInFilterBucketOfNullptr(const void *ptr) {
+    return ((reinterpret_cast<uintptr_t>(ptr) >> 4) * 0x9E3779B97F4A7C15ull >> (64 - 16)) == 0;
+}
+
+// the sampled stacks must hold a return address into the caller of
+// operator new
+__attribute__((noinline)) static void *AllocateHere(size_t size) {
+    void *p = ::operator new(size);
+    asm volatile("" ::: "memory");
+    return p;
+}
+
+static bool HasFrameIn(const char *path, uintptr_t begin, uintptr_t end) {
+    FILE *f = std::fopen(path, "r");
+    assert(f != nullptr);
+    bool found = false;
+    char word[64];
+    while(!found && std::fscanf(f, "%63s", word) == 1) {
+        if(std::strncmp(word, "0x", 2) == 0) {
+            const uintptr_t frame = std::strtoull(word, nullptr, 16);
+            found = frame > begin && frame < end;
+        }
+    }
+    std::fclose(f);
+    return found;
+}
+
+int main() {
+    const char *path = "test_safalo_sampling.heap";
+    const size_t no_allocations = 100;
+    void *ptrs[no_allocations];
+
+    // sample nearly every allocation
+    SafAlo::Get().StartSampling(1);
+    for(size_t i = 0; i < no_allocations; ++i) {
+        ptrs[i] = AllocateHere(64);
+    }
+    SafAlo::Get().StopSampling();
+
+    // the first allocation of a thread may fall into the off interval
+    assert(SafAlo::Get().GetNoOfSampledAllocations() >= no_allocations / 2);
+    assert(SafAlo::Get().DumpHeapProfile(path));
+    assert(::access((std::string(path) + ".tmp").c_str(), F_OK) != 0);
+    const uintptr_t here = reinterpret_cast<uintptr_t>(&AllocateHere);
+    assert(HasFrameIn(path, here, here + 256));
+
+    for(size_t i = 0; i < no_allocations; ++i) {
+        ::operator delete(ptrs[i]);
+    }
+    assert(SafAlo::Get().GetNoOfSampledAllocations() == 0);
+
+    char header[32] = {};
+    FILE *f = std::fopen(path, "r");
+    assert(f != nullptr);
+    size_t n = std::fread(header, 1, sizeof(header) - 1, f);
+    std::fclose(f);
+    std::remove(path);
+    assert(n > 0);
+    assert(std::strncmp(header, "heap profile: ", 14) == 0);
+
+    // a failed dump keeps the previous profile, path.tmp can not be
+    // opened for writing if it is a directory
+    f = std::fopen(path, "w");
+    assert(f != nullptr);
+    std::fputs("previous", f);
+    std::fclose(f);
+    const std::string tmp_path = std::string(path) + ".tmp";
+    assert(::mkdir(tmp_path.c_str(), 0755) == 0);
+    assert(!SafAlo::Get().DumpHeapProfile(path));
+    ::rmdir(tmp_path.c_str());
+    f = std::fopen(path, "r");
+    assert(f != nullptr);
+    std::memset(header, 0, sizeof(header));
+    n = std::fread(header, 1, sizeof(header) - 1, f);
+    std::fclose(f);
+    std::remove(path);
+    assert(std::strcmp(header, "previous") == 0);
+
+    // the same from the signal handler
+    SafAlo::Get().DumpHeapProfileOnSignal(SIGUSR1, path);
+    std::raise(SIGUSR1);
+    f = std::fopen(path, "r");
+    assert(f != nullptr);
+    std::memset(header, 0, sizeof(header));
+    n = std::fread(header, 1, sizeof(header) - 1, f);
+    std::fclose(f);
+    std::remove(path);
+    assert(std::strncmp(header, "heap profile: ", 14) == 0);
+
+    // deleting nullptr must not forget a sample which shares its hash
+    // sample every allocation until one falls into nullptr's bucket, the
+    // chunks of the others are kept busy with plain malloc, so operator new
+    // moves on to new addresses
+    std::vector<void *> fillers;
+    fillers.reserve(1 << 22);
+    SafAlo::Get().StartSampling(1);
+    // use up the interval counted down while sampling was off
+    ::operator delete(::operator new(1 << 20));
+    void *sampled = ::operator new(16);
+    while(!IsInFilterBucketOfNullptr(sampled) && fillers.size() < fillers.capacity()) {
+        ::operator delete(sampled);
+        fillers.push_back(std::malloc(16));
+        sampled = ::operator new(16);
+    }
+    SafAlo::Get().StopSampling();
+    assert(IsInFilterBucketOfNullptr(sampled));
+    assert(SafAlo::Get().GetNoOfSampledAllocations() == 1);
+
+    for(int i = 0; i < 10; ++i) {
+        ::operator delete(nullptr);
+    }
+    assert(SafAlo::Get().GetNoOfSampledAllocations() == 1);
+
+    ::operator delete(sampled);
+    assert(SafAlo::Get().GetNoOfSampledAllocations() == 0);
+    for(auto p : fillers) {
+        std::free(p);
+    }
+}
@@ -6,3 +6,44 @@ TEST(GetTypeName, success) {
     bool typeCheck = std::string("bool") == GetTypeName<bool>();
     assert(typeCheck);  
 }
+
+namespace test_typename {
+    struct TestType1 {};
+    template <class T> struct TestTemplate {};
+}
+
+TEST(GetTypeName, demangled) {
+    // unlike GetTypeNameView, the demangled name keeps default template arguments
+    EXPECT_EQ(GetTypeName<test_typename::TestTemplate<int>>(), "test_typename::TestTemplate<int>");
+    EXPECT_EQ(GetTypeName<std::basic_string<char>>(), "std::__cxx11::basic_string<char, std::char_traits<char>, std::allocator<char> >");
+}
+
+TEST(GetTypeNameView, success) {
+    constexpr TypeNameView name = GetTypeNameView<bool>();
+    static_assert(name == TypeNameView("bool", 4), "type name is not evaluated at compile time");
+    EXPECT_EQ(std::string(GetTypeNameView<test_typename::TestType1>()), "test_typename::TestType1");
+    EXPECT_EQ(std::string(GetTypeNameView<test_typename::TestTemplate<int>>()), "test_typename::TestTemplate<int>");
+    EXPECT_EQ(std::string(GetTypeNameView<int[3]>()), "int [3]");
+}
+
+TEST(GetTypeId, success) {
+    constexpr uint64_t id = GetTypeId<bool>();
+    static_assert(id == GetTypeId<bool>(), "type id is not evaluated at compile time");
+    EXPECT_NE(GetTypeId<bool>(), GetTypeId<int>());
+    EXPECT_NE(GetTypeId<test_typename::TestTemplate<int>>(), GetTypeId<test_typename::TestTemplate<long>>());
+}
+
+TEST(GetTypeKey, success) {
+    constexpr const void *key = GetTypeKey<bool>();
+    static_assert(key == GetTypeKey<bool>(), "type key is not a constant expression");
+    EXPECT_NE(GetTypeKey<bool>(), GetTypeKey<int>());
+
+    // spelled alike, so the ids collide, the keys do not
+    auto a = []{};
+    auto b = []{};
+    using A = test_typename::TestTemplate<decltype(a)>;
+    using B = test_typename::TestTemplate<decltype(b)>;
+    EXPECT_EQ(GetTypeNameView<A>(), GetTypeNameView<B>());
+    EXPECT_EQ(GetTypeId<A>(), GetTypeId<B>());
+    EXPECT_NE(GetTypeKey<A>(), GetTypeKey<B>());
+}
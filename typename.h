@@ -2,12 +2,159 @@
 #ifndef TYPE_NAME_H
 #define TYPE_NAME_H
 
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <ostream>
 #include <string>
+#include <typeinfo>
 #include <cxxabi.h>
 
+/// @brief TypeNameView
+/// @details Non owning view on a type name with static storage duration.
+///          Stands in for std::string_view, which needs C++17.
+class TypeNameView {
+
+    public:
+        constexpr TypeNameView() : data_{""}, size_{0} {}
+        constexpr TypeNameView(const char *data, size_t size) : data_{data}, size_{size} {}
+
+        constexpr const char *data() const {
+            return data_;
+        }
+
+        constexpr size_t size() const {
+            return size_;
+        }
+
+        constexpr char operator[](size_t i) const {
+            return data_[i];
+        }
+
+        explicit operator std::string() const {
+            return std::string(data_, size_);
+        }
+
+    private:
+        const char *data_;
+        size_t size_;
+};
+
+constexpr bool operator==(TypeNameView a, TypeNameView b) {
+    if(a.size() != b.size()) {
+        return false;
+    }
+    for(size_t i = 0; i < a.size(); ++i) {
+        if(a[i] != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr bool operator!=(TypeNameView a, TypeNameView b) {
+    return !(a == b);
+}
+
+inline std::ostream &operator<<(std::ostream &os, TypeNameView name) {
+    return os.write(name.data(), static_cast<std::streamsize>(name.size()));
+}
+
+
+namespace type_name_detail {
+
+/// @brief Cuts the type out of "... [with T = <type>]" (GCC) or "... [T = <type>]" (clang)
+constexpr TypeNameView ParsePrettyFunction(const char *pretty, size_t size) {
+    size_t begin = 0;
+    for(size_t i = 0; i + 4 <= size; ++i) {
+        if(pretty[i] == 'T' && pretty[i + 1] == ' ' && pretty[i + 2] == '=' && pretty[i + 3] == ' ') {
+            begin = i + 4;
+            break;
+        }
+    }
+    // GCC appends "; <typedef> = <type>" for typedefs used in the signature
+    size_t end = size - 1;
+    for(size_t i = begin; i < size; ++i) {
+        if(pretty[i] == ';') {
+            end = i;
+            break;
+        }
+    }
+    return TypeNameView(pretty + begin, end - begin);
+}
+
+template <class T>
+constexpr TypeNameView PrettyTypeName() {
+    return ParsePrettyFunction(__PRETTY_FUNCTION__, sizeof(__PRETTY_FUNCTION__) - 1);
+}
+
+// FNV-1a
+constexpr uint64_t Hash(TypeNameView name) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(size_t i = 0; i < name.size(); ++i) {
+        hash ^= static_cast<unsigned char>(name[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+template <class T>
+struct TypeInfo {
+    static constexpr TypeNameView name = PrettyTypeName<T>();
+    static constexpr uint64_t id = Hash(name);
+    // only the address matters, it is the key of T
+    static const char key;
+};
+
+template <class T>
+constexpr TypeNameView TypeInfo<T>::name;
+
+template <class T>
+constexpr uint64_t TypeInfo<T>::id;
+
+template <class T>
+const char TypeInfo<T>::key = 0;
+
+} // namespace type_name_detail
+
+
+/// @brief GetTypeNameView
+/// @details Evaluated at compile time, neither allocates nor demangles.
+///          The spelling is the compiler's and can differ from GetTypeName,
+///          default template arguments are left out and local types read
+///          main()::X instead of main::X.
+/// @tparam T
+/// @return name of T as spelled by the compiler
+template <class T>
+constexpr TypeNameView GetTypeNameView() {
+    return type_name_detail::TypeInfo<T>::name;
+}
+
+/// @brief GetTypeId
+/// @details Hash of the type name, stable across runs of the same build.
+///          Types spelled alike share the id, e.g. {anonymous}::X of two
+///          translation units or two lambdas of one function. Use
+///          GetTypeKey to tell types apart.
+/// @tparam T
+/// @return id of T
+template <class T>
+constexpr uint64_t GetTypeId() {
+    return type_name_detail::TypeInfo<T>::id;
+}
+
+/// @brief GetTypeKey
+/// @details Address of a static of T, distinct for every type of the 
+///          process, but not stable across runs.
+/// @tparam T
+/// @return key of T
+template <class T>
+constexpr const void *GetTypeKey() {
+    return &type_name_detail::TypeInfo<T>::key;
+}
+
 /// @brief GetTypeName
 /// @tparam T 
-/// @return returns the demangled name of T
+/// @return returns the demangled name of T, see GetTypeNameView for a non allocating version
 template <class T>
 std::string GetTypeName() {
     auto m_name = typeid(T).name();
@@ -27,4 +174,4 @@ std::string GetTypeName() {
 }
 
 
-#endif // TYPE_NAME_H
\ No newline at end of file
+#endif // TYPE_NAME_H